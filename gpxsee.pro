@@ -115,6 +115,7 @@ HEADERS += src/common/config.h \
     src/map/textpathitem.h \
     src/map/textpointitem.h \
     src/map/mapsforge/datomapa.h \
+    src/map/mapsforge/diccionario.h \
     src/map/mapsforge/mosaicotrama.h \
     src/map/mapsforge/subficher.h \
     src/map/bsbmap.h \
@@ -135,6 +136,7 @@ HEADERS += src/common/config.h \
     src/map/map.h \
     src/map/maplist.h \
     src/map/onlinemap.h \
+    src/map/demmap.h \
     src/map/downloader.h \
     src/map/tile.h \
     src/map/emptymap.h \
@@ -178,7 +180,9 @@ HEADERS += src/common/config.h \
     src/data/track.h \
     src/data/route.h \
     src/data/trackpoint.h \
+    src/data/segmentdata.h \
     src/data/data.h \
+    src/data/dataloader.h \
     src/data/parser.h \
     src/data/trackdata.h \
     src/data/routedata.h \
@@ -211,6 +215,7 @@ HEADERS += src/common/config.h \
     src/map/IMG/lblfile.h \
     src/map/IMG/vectortile.h \
     src/map/IMG/subdiv.h \
+    src/map/IMG/subdivcache.h \
     src/map/IMG/style.h \
     src/map/IMG/netfile.h \
     src/GUI/projectioncombobox.h \
@@ -228,6 +233,10 @@ HEADERS += src/common/config.h \
     src/GUI/timezoneinfo.h \
     src/map/aqmmap.h \
     src/map/mapsforgemap.h \
+    src/map/rendercache.h \
+    src/map/tilecache.h \
+    src/map/tiffimage.h \
+    src/map/filetile.h \
     src/map/worldfilemap.h
 
 SOURCES += src/main.cpp \
@@ -309,12 +318,14 @@ SOURCES += src/main.cpp \
     src/map/textpathitem.cpp \
     src/map/textpointitem.cpp \
     src/map/mapsforge/datomapa.cpp \
+    src/map/mapsforge/diccionario.cpp \
     src/map/mapsforge/mosaicotrama.cpp \
     src/map/mapsforge/subficher.cpp \
     src/map/bsbmap.cpp \
     src/map/kmzmap.cpp \
     src/map/maplist.cpp \
     src/map/onlinemap.cpp \
+    src/map/demmap.cpp \
     src/map/downloader.cpp \
     src/map/emptymap.cpp \
     src/map/ozimap.cpp \
@@ -362,8 +373,10 @@ SOURCES += src/main.cpp \
     src/map/polarstereographic.cpp \
     src/map/rectd.cpp \
     src/data/data.cpp \
+    src/data/dataloader.cpp \
     src/data/poi.cpp \
     src/data/track.cpp \
+    src/data/segmentdata.cpp \
     src/data/route.cpp \
     src/data/path.cpp \
     src/data/gpxparser.cpp \
@@ -402,6 +415,10 @@ SOURCES += src/main.cpp \
     src/data/geojsonparser.cpp \
     src/map/aqmmap.cpp \
     src/map/mapsforgemap.cpp \
+    src/map/rendercache.cpp \
+    src/map/tilecache.cpp \
+    src/map/tiffimage.cpp \
+    src/map/filetile.cpp \
     src/map/worldfilemap.cpp \
     src/GUI/projectioncombobox.cpp
 
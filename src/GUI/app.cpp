@@ -78,25 +78,10 @@ App::~App()
 
 int App::run()
 {
-	MapAction *lastReady = 0;
 	QStringList args(arguments());
 
 	_gui->show();
-
-	for (int i = 1; i < args.count(); i++) {
-		if (!_gui->openFile(args.at(i), true)) {
-			MapAction *a;
-			if (!_gui->loadMap(args.at(i), a, true))
-				_gui->openFile(args.at(i), false);
-			else {
-				if (a)
-					lastReady = a;
-			}
-		}
-	}
-
-	if (lastReady)
-		lastReady->trigger();
+	_gui->openFiles(args.mid(1));
 
 	return exec();
 }
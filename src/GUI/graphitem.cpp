@@ -1,9 +1,46 @@
+#include <QtMath>
 #include <QPainter>
 #include <QGraphicsSceneMouseEvent>
 #include "popup.h"
 #include "graphitem.h"
 
 
+static QVector<QVector<int> > pyramid(const GraphSegment &segment)
+{
+	QVector<QVector<int> > levels;
+	QVector<int> l;
+	int n = segment.size();
+
+	l.reserve(n + 1);
+	for (int i = 0; i < n; i += 2) {
+		int j = qMin(i + 1, n - 1);
+		bool lower = (segment.at(i).y() <= segment.at(j).y());
+		l.append(lower ? i : j);
+		l.append(lower ? j : i);
+	}
+
+	while (l.size() > 2) {
+		levels.append(l);
+
+		QVector<int> next;
+		next.reserve(l.size() / 2 + 2);
+		for (int i = 0; i < l.size(); i += 4) {
+			if (i + 2 < l.size()) {
+				next.append((segment.at(l.at(i)).y()
+				  <= segment.at(l.at(i+2)).y()) ? l.at(i) : l.at(i+2));
+				next.append((segment.at(l.at(i+1)).y()
+				  >= segment.at(l.at(i+3)).y()) ? l.at(i+1) : l.at(i+3));
+			} else {
+				next.append(l.at(i));
+				next.append(l.at(i+1));
+			}
+		}
+		l = next;
+	}
+
+	return levels;
+}
+
 GraphItem::GraphItem(const Graph &graph, GraphType type, int width,
   const QColor &color, Qt::PenStyle style, QGraphicsItem *parent)
   : GraphicsItem(parent), _graph(graph), _type(type), _secondaryGraph(0)
@@ -17,6 +54,19 @@ GraphItem::GraphItem(const Graph &graph, GraphType type, int width,
 	setZValue(2.0);
 	setAcceptHoverEvents(true);
 
+	qreal ymin = _graph.first().first().y();
+	qreal ymax = ymin;
+	_pyramids.reserve(_graph.size());
+	for (int i = 0; i < _graph.size(); i++) {
+		const GraphSegment &segment = _graph.at(i);
+		for (int j = 0; j < segment.size(); j++) {
+			ymin = qMin(ymin, segment.at(j).y());
+			ymax = qMax(ymax, segment.at(j).y());
+		}
+		_pyramids.append(pyramid(segment));
+	}
+	_yRange = RangeF(ymin, ymax);
+
 	updateBounds();
 }
 
@@ -220,6 +270,27 @@ void GraphItem::setScale(qreal sx, qreal sy)
 	updatePath();
 }
 
+/* The finest decimation level of the segment with groups not wider than
+   a pixel (on average) at the current scale */
+int GraphItem::level(int segment) const
+{
+	const GraphSegment &seg = _graph.at(segment);
+	const Pyramid &pyramid = _pyramids.at(segment);
+	qreal width = (seg.last().x(_type) - seg.first().x(_type)) * _sx;
+
+	if (!(width > 0))
+		return pyramid.size();
+
+	qreal ppp = (seg.size() - 1) / width;
+	if (ppp < 2)
+		return 0;
+
+	return qMin(qFloor(log2(ppp)), pyramid.size());
+}
+
+/* The graph is drawn decimated to the pixel resolution using the precomputed
+   min/max pyramid, so the path size (and the time to create it) only depends
+   on the on-screen graph width and not on the number of the graph points. */
 void GraphItem::updatePath()
 {
 	if (_sx == 0 && _sy == 0)
@@ -232,18 +303,37 @@ void GraphItem::updatePath()
 	if (!(_type == Time && !_time)) {
 		for (int i = 0; i < _graph.size(); i++) {
 			const GraphSegment &segment = _graph.at(i);
+			int l = level(i);
 
 			_path.moveTo(segment.first().x(_type) * _sx, -segment.first().y()
 			  * _sy);
-			for (int i = 1; i < segment.size(); i++)
-				_path.lineTo(segment.at(i).x(_type) * _sx, -segment.at(i).y()
-				  * _sy);
+
+			if (l) {
+				const QVector<int> &groups = _pyramids.at(i).at(l - 1);
+				for (int j = 0; j < groups.size(); j += 2) {
+					int a = qMin(groups.at(j), groups.at(j+1));
+					int b = qMax(groups.at(j), groups.at(j+1));
+					_path.lineTo(segment.at(a).x(_type) * _sx,
+					  -segment.at(a).y() * _sy);
+					if (b != a)
+						_path.lineTo(segment.at(b).x(_type) * _sx,
+						  -segment.at(b).y() * _sy);
+				}
+				_path.lineTo(segment.last().x(_type) * _sx,
+				  -segment.last().y() * _sy);
+			} else {
+				for (int j = 1; j < segment.size(); j++)
+					_path.lineTo(segment.at(j).x(_type) * _sx,
+					  -segment.at(j).y() * _sy);
+			}
 		}
 	}
 
 	updateShape();
 }
 
+/* The graph x values are nondecreasing, so only the y range, that does not
+   depend on the graph type, has to be computed from all the graph points. */
 void GraphItem::updateBounds()
 {
 	if (_type == Time && !_time) {
@@ -251,60 +341,20 @@ void GraphItem::updateBounds()
 		return;
 	}
 
-	qreal bottom, top, left, right;
-
-	QPointF p = QPointF(_graph.first().first().x(_type),
-	  -_graph.first().first().y());
-	bottom = p.y(); top = p.y(); left = p.x(); right = p.x();
+	qreal left = _graph.first().first().x(_type);
+	qreal right = left;
 
 	for (int i = 0; i < _graph.size(); i++) {
 		const GraphSegment &segment = _graph.at(i);
-
-		for (int j = 0; j < segment.size(); j++) {
-			p = QPointF(segment.at(j).x(_type), -segment.at(j).y());
-			bottom = qMax(bottom, p.y()); top = qMin(top, p.y());
-			right = qMax(right, p.x()); left = qMin(left, p.x());
-		}
+		left = qMin(left, segment.first().x(_type));
+		right = qMax(right, segment.last().x(_type));
 	}
 
 	if (left == right)
 		_bounds = QRectF();
 	else
-		_bounds = QRectF(QPointF(left, top), QPointF(right, bottom));
-}
-
-qreal GraphItem::max() const
-{
-	qreal ret = _graph.first().first().y();
-
-	for (int i = 0; i < _graph.size(); i++) {
-		const GraphSegment &segment = _graph.at(i);
-
-		for (int j = 0; j < segment.size(); j++) {
-			qreal y = segment.at(j).y();
-			if (y > ret)
-				ret = y;
-		}
-	}
-
-	return ret;
-}
-
-qreal GraphItem::min() const
-{
-	qreal ret = _graph.first().first().y();
-
-	for (int i = 0; i < _graph.size(); i++) {
-		const GraphSegment &segment = _graph.at(i);
-
-		for (int j = 0; j < segment.size(); j++) {
-			qreal y = segment.at(j).y();
-			if (y < ret)
-				ret = y;
-		}
-	}
-
-	return ret;
+		_bounds = QRectF(QPointF(left, -_yRange.max()),
+		  QPointF(right, -_yRange.min()));
 }
 
 qreal GraphItem::avg() const
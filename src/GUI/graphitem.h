@@ -3,6 +3,7 @@
 
 #include <QGraphicsObject>
 #include <QPen>
+#include "common/range.h"
 #include "data/graph.h"
 #include "units.h"
 #include "graphicsscene.h"
@@ -26,8 +27,8 @@ public:
 	GraphType graphType() const {return _type;}
 	const QRectF &bounds() const {return _bounds;}
 
-	qreal max() const;
-	qreal min() const;
+	qreal max() const {return _yRange.max();}
+	qreal min() const {return _yRange.min();}
 	qreal avg() const;
 
 	void setScale(qreal sx, qreal sy);
@@ -59,12 +60,20 @@ protected:
 	Units _units;
 
 private:
+	/* Min/max decimation levels of a graph segment. Level k (stored at index
+	   k-1) consists of groups of 2^k consecutive points, for every group the
+	   indexes of its min and max y value points are stored. */
+	typedef QVector<QVector<int> > Pyramid;
+
 	const GraphSegment *segment(qreal x, GraphType type) const;
+	int level(int segment) const;
 	void updatePath();
 	void updateShape();
 	void updateBounds();
 
 	Graph _graph;
+	QVector<Pyramid> _pyramids;
+	RangeF _yRange;
 	GraphType _type;
 	QPainterPath _path;
 	QPainterPath _shape;
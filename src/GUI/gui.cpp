@@ -16,21 +16,25 @@
 #include <QActionGroup>
 #include <QAction>
 #include <QLabel>
+#include <QProgressBar>
+#include <QToolButton>
 #include <QSettings>
 #include <QLocale>
 #include <QMimeData>
 #include <QUrl>
-#include <QPixmapCache>
 #include <QWindow>
 #include <QScreen>
 #include <QStyle>
 #include <QTabBar>
 #include "common/programpaths.h"
 #include "data/data.h"
+#include "data/dataloader.h"
 #include "data/poi.h"
 #include "map/maplist.h"
 #include "map/emptymap.h"
 #include "map/downloader.h"
+#include "map/rendercache.h"
+#include "map/tilecache.h"
 #include "map/crs.h"
 #include "icons.h"
 #include "keys.h"
@@ -63,6 +67,11 @@ GUI::GUI()
 
 	_poi = new POI(this);
 
+	_dataLoader = new DataLoader(this);
+	connect(_dataLoader, &DataLoader::loaded, this, &GUI::dataLoaded);
+	connect(_dataLoader, &DataLoader::progress, this, &GUI::dataProgress);
+	connect(_dataLoader, &DataLoader::finished, this, &GUI::dataFinished);
+
 	createMapView();
 	createGraphTabs();
 	createStatusBar();
@@ -716,7 +725,18 @@ void GUI::createStatusBar()
 	_distanceLabel->setAlignment(Qt::AlignHCenter);
 	_timeLabel->setAlignment(Qt::AlignHCenter);
 
+	_progressBar = new QProgressBar();
+	_progressBar->setTextVisible(false);
+	_progressBar->setVisible(false);
+	_cancelButton = new QToolButton();
+	_cancelButton->setText(tr("Cancel"));
+	_cancelButton->setAutoRaise(true);
+	_cancelButton->setVisible(false);
+	connect(_cancelButton, &QToolButton::clicked, this, &GUI::cancelLoading);
+
 	statusBar()->addPermanentWidget(_fileNameLabel, 8);
+	statusBar()->addPermanentWidget(_progressBar, 2);
+	statusBar()->addPermanentWidget(_cancelButton);
 	statusBar()->addPermanentWidget(_distanceLabel, 1);
 	statusBar()->addPermanentWidget(_timeLabel, 1);
 	statusBar()->setSizeGripEnabled(false);
@@ -814,8 +834,7 @@ void GUI::openFile()
 	QStringList files(QFileDialog::getOpenFileNames(this, tr("Open file"),
 	  _dataDir, Data::formats()));
 
-	for (int i = 0; i < files.size(); i++)
-		openFile(files.at(i));
+	openDataFiles(files);
 	if (!files.isEmpty())
 		_dataDir = QFileInfo(files.last()).path();
 }
@@ -842,6 +861,133 @@ bool GUI::openFile(const QString &fileName, bool silent)
 	return true;
 }
 
+/* Files with a known data file suffix are loaded in the background, all
+   other files are tried as maps first and then as data files of an unknown
+   format. */
+void GUI::openFiles(const QStringList &files)
+{
+	QStringList filter(Data::filter());
+	QStringList dataFiles;
+	MapAction *lastReady = 0;
+
+	for (int i = 0; i < files.size(); i++) {
+		const QString &file = files.at(i);
+
+		if (filter.contains("*." + QFileInfo(file).suffix().toLower()))
+			dataFiles.append(file);
+		else {
+			MapAction *a;
+			if (!loadMap(file, a, true))
+				openFile(file, false);
+			else {
+				if (a)
+					lastReady = a;
+			}
+		}
+	}
+
+	openDataFiles(dataFiles);
+
+	if (lastReady)
+		lastReady->trigger();
+}
+
+void GUI::openDataFiles(const QStringList &files)
+{
+	QStringList list;
+
+	for (int i = 0; i < files.size(); i++)
+		if (!_files.contains(files.at(i)) && !list.contains(files.at(i)))
+			list.append(files.at(i));
+	if (list.isEmpty())
+		return;
+
+	_files.append(list);
+	loadFiles(list);
+}
+
+void GUI::loadFiles(const QStringList &files)
+{
+	if (files.isEmpty())
+		return;
+
+	if (_loading.isEmpty()) {
+		_progressBar->setRange(0, files.size());
+		_progressBar->setValue(0);
+	} else
+		_progressBar->setMaximum(_progressBar->maximum() + files.size());
+	_progressBar->setVisible(true);
+	_cancelButton->setVisible(true);
+
+	_loading.append(files);
+	_dataLoader->load(files);
+}
+
+void GUI::dataLoaded(const QString &fileName, const Data &data)
+{
+	_loading.removeOne(fileName);
+
+	if (data.isValid()) {
+		loadData(data);
+
+		_fileActionGroup->setEnabled(true);
+		// Explicitly enable the reload action as it may be disabled by loadMapDir()
+		_reloadFileAction->setEnabled(true);
+		_navigationActionGroup->setEnabled(true);
+	} else {
+		_files.removeOne(fileName);
+
+		QString error = fileName + "\n" + data.errorString();
+		if (data.errorLine())
+			error.append("\n" + tr("Line: %1").arg(data.errorLine()));
+		_loadErrors.append(error);
+	}
+}
+
+void GUI::dataProgress(int loaded, int total)
+{
+	_progressBar->setMaximum(total);
+	_progressBar->setValue(loaded);
+
+	updateNavigationActions();
+	updateStatusBarInfo();
+	updateWindowTitle();
+	updateGraphTabs();
+}
+
+void GUI::dataFinished()
+{
+	_progressBar->setVisible(false);
+	_cancelButton->setVisible(false);
+
+	if (_files.isEmpty())
+		_fileActionGroup->setEnabled(false);
+	else
+		_browser->setCurrent(_files.last());
+
+	updateNavigationActions();
+	updateStatusBarInfo();
+	updateWindowTitle();
+
+	if (!_loadErrors.isEmpty()) {
+		QString error = tr("Error loading data file:") + "\n\n"
+		  + _loadErrors.join("\n\n");
+		_loadErrors.clear();
+		QMessageBox::critical(this, APP_NAME, error);
+	}
+}
+
+void GUI::cancelLoading()
+{
+	_dataLoader->cancel();
+
+	for (int i = 0; i < _loading.size(); i++)
+		_files.removeOne(_loading.at(i));
+	_loading.clear();
+
+	dataFinished();
+}
+
 bool GUI::loadFile(const QString &fileName, bool silent)
 {
 	Data data(fileName, !silent);
@@ -903,7 +1049,15 @@ void GUI::loadData(const Data &data)
 	if (updateGraphTabs())
 		_splitter->refresh();
 	paths = _mapView->loadData(data);
+	linkGraphs(graphs, paths);
 
+	_data.append(data);
+	_paths.append(paths);
+}
+
+void GUI::linkGraphs(const QList<QList<GraphItem*> > &graphs,
+  const QList<PathItem*> &paths)
+{
 	GraphTab *gt = static_cast<GraphTab*>(_graphTabWidget->currentWidget());
 
 	for (int i = 0; i < paths.count(); i++) {
@@ -921,6 +1075,28 @@ void GUI::loadData(const Data &data)
 	}
 }
 
+/* The tracks keep the graphs that are not affected by the filter change, so
+   only the changed graphs get recomputed */
+void GUI::reloadGraphs()
+{
+	for (int i = 0; i < _paths.count(); i++)
+		for (int j = 0; j < _paths.at(i).count(); j++)
+			if (_paths.at(i).at(j))
+				_paths.at(i).at(j)->clearGraphs();
+	for (int i = 0; i < _tabs.count(); i++)
+		_tabs.at(i)->clear();
+
+	for (int i = 0; i < _data.count(); i++) {
+		QList<QList<GraphItem*> > graphs;
+		for (int j = 0; j < _tabs.count(); j++)
+			graphs.append(_tabs.at(j)->loadData(_data.at(i)));
+		linkGraphs(graphs, _paths.at(i));
+	}
+
+	if (updateGraphTabs())
+		_splitter->refresh();
+}
+
 void GUI::openPOIFile()
 {
 	QStringList files(QFileDialog::getOpenFileNames(this, tr("Open POI file"),
@@ -973,6 +1149,11 @@ void GUI::openOptions()
 		Track::action(options.option); \
 		reload = true; \
 	}
+#define SET_FILTER_OPTION(option, action) \
+	if (options.option != _options.option) { \
+		Track::action(options.option); \
+		regraph = true; \
+	}
 #define SET_ROUTE_OPTION(option, action) \
 	if (options.option != _options.option) { \
 		Route::action(options.option); \
@@ -985,7 +1166,7 @@ void GUI::openOptions()
 	}
 
 	Options options(_options);
-	bool reload = false;
+	bool reload = false, regraph = false;
 
 	OptionsDialog dialog(options, _units, this);
 	if (dialog.exec() != QDialog::Accepted)
@@ -1028,11 +1209,11 @@ void GUI::openOptions()
 	SET_TAB_OPTION(useOpenGL, useOpenGL);
 	SET_TAB_OPTION(sliderColor, setSliderColor);
 
-	SET_TRACK_OPTION(elevationFilter, setElevationFilter);
-	SET_TRACK_OPTION(speedFilter, setSpeedFilter);
-	SET_TRACK_OPTION(heartRateFilter, setHeartRateFilter);
-	SET_TRACK_OPTION(cadenceFilter, setCadenceFilter);
-	SET_TRACK_OPTION(powerFilter, setPowerFilter);
+	SET_FILTER_OPTION(elevationFilter, setElevationFilter);
+	SET_FILTER_OPTION(speedFilter, setSpeedFilter);
+	SET_FILTER_OPTION(heartRateFilter, setHeartRateFilter);
+	SET_FILTER_OPTION(cadenceFilter, setCadenceFilter);
+	SET_FILTER_OPTION(powerFilter, setPowerFilter);
 	SET_TRACK_OPTION(outlierEliminate, setOutlierElimination);
 	SET_TRACK_OPTION(automaticPause, setAutomaticPause);
 	SET_TRACK_OPTION(pauseSpeed, setPauseSpeed);
@@ -1053,7 +1234,9 @@ void GUI::openOptions()
 		_poi->setRadius(options.poiRadius);
 
 	if (options.pixmapCache != _options.pixmapCache)
-		QPixmapCache::setCacheLimit(options.pixmapCache * 1024);
+		TileCache::setLimit(options.pixmapCache * 1024);
+	if (options.renderCache != _options.renderCache)
+		RenderCache::setSize(options.renderCache);
 
 	if (options.connectionTimeout != _options.connectionTimeout)
 		Downloader::setTimeout(options.connectionTimeout);
@@ -1069,6 +1252,8 @@ void GUI::openOptions()
 
 	if (reload)
 		reloadFiles();
+	else if (regraph)
+		reloadGraphs();
 
 	_options = options;
 }
@@ -1336,6 +1521,10 @@ void GUI::plot(QPrinter *printer)
 
 void GUI::reloadFiles()
 {
+	_dataLoader->cancel();
+	_loading.clear();
+	_loadErrors.clear();
+
 	_trackCount = 0;
 	_routeCount = 0;
 	_waypointCount = 0;
@@ -1350,24 +1539,23 @@ void GUI::reloadFiles()
 	for (int i = 0; i < _tabs.count(); i++)
 		_tabs.at(i)->clear();
 	_mapView->clear();
+	_data.clear();
+	_paths.clear();
 
-	for (int i = 0; i < _files.size(); i++) {
-		if (!loadFile(_files.at(i))) {
-			_files.removeAt(i);
-			i--;
-		}
-	}
-
-	updateStatusBarInfo();
-	updateWindowTitle();
 	if (_files.isEmpty())
-		_fileActionGroup->setEnabled(false);
+		dataFinished();
 	else
-		_browser->setCurrent(_files.last());
+		loadFiles(_files);
 }
 
 void GUI::closeFiles()
 {
+	_dataLoader->cancel();
+	_loading.clear();
+	_loadErrors.clear();
+	_progressBar->setVisible(false);
+	_cancelButton->setVisible(false);
+
 	_trackCount = 0;
 	_routeCount = 0;
 	_waypointCount = 0;
@@ -1384,6 +1572,8 @@ void GUI::closeFiles()
 	_lastTab = 0;
 
 	_mapView->clear();
+	_data.clear();
+	_paths.clear();
 
 	_files.clear();
 }
@@ -1990,25 +2180,13 @@ void GUI::dragEnterEvent(QDragEnterEvent *event)
 
 void GUI::dropEvent(QDropEvent *event)
 {
-	MapAction *lastReady = 0;
 	QList<QUrl> urls(event->mimeData()->urls());
+	QStringList files;
 
-	for (int i = 0; i < urls.size(); i++) {
-		QString file(urls.at(i).toLocalFile());
-
-		if (!openFile(file, true)) {
-			MapAction *a;
-			if (!loadMap(file, a, true))
-				openFile(file, false);
-			else {
-				if (a)
-					lastReady = a;
-			}
-		}
-	}
+	for (int i = 0; i < urls.size(); i++)
+		files.append(urls.at(i).toLocalFile());
 
-	if (lastReady)
-		lastReady->trigger();
+	openFiles(files);
 
 	event->acceptProposedAction();
 }
@@ -2242,6 +2420,8 @@ void GUI::writeSettings()
 		settings.setValue(ENABLE_HTTP2_SETTING, _options.enableHTTP2);
 	if (_options.pixmapCache != PIXMAP_CACHE_DEFAULT)
 		settings.setValue(PIXMAP_CACHE_SETTING, _options.pixmapCache);
+	if (_options.renderCache != RENDER_CACHE_DEFAULT)
+		settings.setValue(RENDER_CACHE_SETTING, _options.renderCache);
 	if (_options.connectionTimeout != CONNECTION_TIMEOUT_DEFAULT)
 		settings.setValue(CONNECTION_TIMEOUT_SETTING, _options.connectionTimeout);
 	if (_options.hiresPrint != HIRES_PRINT_DEFAULT)
@@ -2553,6 +2733,8 @@ void GUI::readSettings()
 	  ENABLE_HTTP2_DEFAULT).toBool();
 	_options.pixmapCache = settings.value(PIXMAP_CACHE_SETTING,
 	  PIXMAP_CACHE_DEFAULT).toInt();
+	_options.renderCache = settings.value(RENDER_CACHE_SETTING,
+	  RENDER_CACHE_DEFAULT).toInt();
 	_options.connectionTimeout = settings.value(CONNECTION_TIMEOUT_SETTING,
 	  CONNECTION_TIMEOUT_DEFAULT).toInt();
 	_options.hiresPrint = settings.value(HIRES_PRINT_SETTING,
@@ -2641,7 +2823,8 @@ void GUI::readSettings()
 
 	_poi->setRadius(_options.poiRadius);
 
-	QPixmapCache::setCacheLimit(_options.pixmapCache * 1024);
+	TileCache::setLimit(_options.pixmapCache * 1024);
+	RenderCache::setSize(_options.renderCache);
 
 	settings.endGroup();
 }
@@ -3,11 +3,13 @@
 
 #include <QMainWindow>
 #include <QString>
+#include <QStringList>
 #include <QList>
 #include <QDate>
 #include <QPrinter>
 #include "common/treenode.h"
 #include "data/graph.h"
+#include "data/data.h"
 #include "units.h"
 #include "timetype.h"
 #include "format.h"
@@ -21,6 +23,8 @@ class QTabWidget;
 class QActionGroup;
 class QAction;
 class QLabel;
+class QProgressBar;
+class QToolButton;
 class QSplitter;
 class QPrinter;
 class FileBrowser;
@@ -31,7 +35,9 @@ class POI;
 class QScreen;
 class MapAction;
 class POIAction;
-class Data;
+class DataLoader;
+class PathItem;
+class GraphItem;
 
 class GUI : public QMainWindow
 {
@@ -41,6 +47,7 @@ public:
 	GUI();
 
 	bool openFile(const QString &fileName, bool silent = false);
+	void openFiles(const QStringList &files);
 	bool loadMap(const QString &fileName, MapAction *&action,
 	  bool silent = false);
 	void show();
@@ -102,6 +109,11 @@ private slots:
 	void mapLoadedDir();
 	void mapInitialized();
 
+	void dataLoaded(const QString &fileName, const Data &data);
+	void dataProgress(int loaded, int total);
+	void dataFinished();
+	void cancelLoading();
+
 private:
 	typedef QPair<QDateTime, QDateTime> DateTimeRange;
 
@@ -130,7 +142,12 @@ private:
 
 	bool openPOIFile(const QString &fileName);
 	bool loadFile(const QString &fileName, bool silent = false);
+	void openDataFiles(const QStringList &files);
+	void loadFiles(const QStringList &files);
 	void loadData(const Data &data);
+	void linkGraphs(const QList<QList<GraphItem*> > &graphs,
+	  const QList<PathItem*> &paths);
+	void reloadGraphs();
 	bool loadMapNode(const TreeNode<Map*> &node, MapAction *&action,
 	  bool silent, const QList<QAction*> &existingActions);
 	void loadMapDirNode(const TreeNode<Map*> &node, QList<MapAction*> &actions,
@@ -230,6 +247,8 @@ private:
 	QLabel *_fileNameLabel;
 	QLabel *_distanceLabel;
 	QLabel *_timeLabel;
+	QProgressBar *_progressBar;
+	QToolButton *_cancelButton;
 
 	QSplitter *_splitter;
 	MapView *_mapView;
@@ -243,6 +262,15 @@ private:
 	FileBrowser *_browser;
 	QList<QString> _files;
 
+	DataLoader *_dataLoader;
+	QStringList _loading;
+	QStringList _loadErrors;
+
+	/* The loaded data is kept to recompute the graphs on filter changes
+	   without reloading the files */
+	QList<Data> _data;
+	QList<QList<PathItem*> > _paths;
+
 	int _trackCount, _routeCount, _areaCount, _waypointCount;
 	qreal _trackDistance, _routeDistance;
 	qreal _time, _movingTime;
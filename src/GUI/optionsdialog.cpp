@@ -13,6 +13,8 @@
 #include <QLabel>
 #include <QSysInfo>
 #include <QButtonGroup>
+#include <QLocale>
+#include "map/tilecache.h"
 #include "icons.h"
 #include "colorbox.h"
 #include "stylecombobox.h"
@@ -650,6 +652,21 @@ QWidget *OptionsDialog::createExportPage()
 	return exportPage;
 }
 
+static qreal hitRatio(const TileCache::Stats &stats)
+{
+	qint64 lookups = stats.hits + stats.misses;
+	return lookups ? (100.0 * stats.hits) / lookups : 0;
+}
+
+static QString tileCacheInfo(const TileCache::Stats &stats)
+{
+	QLocale l(QLocale::system());
+
+	return OptionsDialog::tr("%1 MB in %2 tiles, %3 % hits, %4 evicted").arg(
+	  l.toString(stats.size / 1048576.0, 'f', 1), l.toString(stats.tiles),
+	  l.toString(hitRatio(stats), 'f', 0), l.toString(stats.evictions));
+}
+
 QWidget *OptionsDialog::createSystemPage()
 {
 	_useOpenGL = new QCheckBox(tr("Use OpenGL"));
@@ -663,6 +680,25 @@ QWidget *OptionsDialog::createSystemPage()
 	_pixmapCache->setSuffix(UNIT_SPACE + tr("MB"));
 	_pixmapCache->setValue(_options.pixmapCache);
 
+	/* Read-only cache diagnostics, the per map details are in the tooltip */
+	QLabel *pixmapCacheInfo = new QLabel(tileCacheInfo(TileCache::stats()));
+	QList<QPair<QString, TileCache::Stats> > ps(TileCache::partitionStats());
+	QStringList details;
+	for (int i = 0; i < ps.size(); i++)
+		details.append(ps.at(i).first + ": " + tileCacheInfo(ps.at(i).second));
+	pixmapCacheInfo->setToolTip(details.join("\n"));
+	pixmapCacheInfo->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+	_renderCache = new QSpinBox();
+	_renderCache->setMinimum(0);
+	_renderCache->setMaximum(10240);
+	_renderCache->setSingleStep(64);
+	_renderCache->setSuffix(UNIT_SPACE + tr("MB"));
+	_renderCache->setSpecialValueText(tr("Disabled"));
+	_renderCache->setValue(_options.renderCache);
+	_renderCache->setToolTip(tr("Disk cache of rendered vector map tiles"
+	  " (Garmin IMG, Mapsforge)"));
+
 	_connectionTimeout = new QSpinBox();
 	_connectionTimeout->setMinimum(30);
 	_connectionTimeout->setMaximum(120);
@@ -671,6 +707,8 @@ QWidget *OptionsDialog::createSystemPage()
 
 	QFormLayout *formLayout = new QFormLayout();
 	formLayout->addRow(tr("Image cache size:"), _pixmapCache);
+	formLayout->addRow(tr("Image cache usage:"), pixmapCacheInfo);
+	formLayout->addRow(tr("Tiles disk cache size:"), _renderCache);
 	formLayout->addRow(tr("Connection timeout:"), _connectionTimeout);
 
 	QFormLayout *checkboxLayout = new QFormLayout();
@@ -834,6 +872,7 @@ void OptionsDialog::accept()
 	_options.useOpenGL = _useOpenGL->isChecked();
 	_options.enableHTTP2 = _enableHTTP2->isChecked();
 	_options.pixmapCache = _pixmapCache->value();
+	_options.renderCache = _renderCache->value();
 	_options.connectionTimeout = _connectionTimeout->value();
 	_options.dataPath = _dataPath->dir();
 	_options.mapsPath = _mapsPath->dir();
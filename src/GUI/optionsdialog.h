@@ -65,6 +65,7 @@ struct Options {
 	bool useOpenGL;
 	bool enableHTTP2;
 	int pixmapCache;
+	int renderCache;
 	int connectionTimeout;
 	QString dataPath;
 	QString mapsPath;
@@ -155,6 +156,7 @@ private:
 	QDoubleSpinBox *_poiRadius;
 	// System
 	QSpinBox *_pixmapCache;
+	QSpinBox *_renderCache;
 	QSpinBox *_connectionTimeout;
 	QCheckBox *_useOpenGL;
 	QCheckBox *_enableHTTP2;
@@ -3,6 +3,7 @@
 #include <QPainter>
 #include <QGraphicsSceneMouseEvent>
 #include "common/greatcircle.h"
+#include "common/wgs84.h"
 #include "map/map.h"
 #include "pathtickitem.h"
 #include "popup.h"
@@ -18,6 +19,8 @@
 #endif // QT 5.15
 
 #define GEOGRAPHICAL_MILE 1855.3248
+/* Max path simplification error in pixels */
+#define TOLERANCE 0.5
 
 static inline bool isValid(const QPointF &p)
 {
@@ -29,6 +32,72 @@ static inline unsigned segments(qreal distance)
 	return ceil(distance / GEOGRAPHICAL_MILE);
 }
 
+static qreal distance(const QPointF &p, const QPointF &a, const QPointF &b)
+{
+	QPointF ab(b - a), ap(p - a);
+	qreal l = QPointF::dotProduct(ab, ab);
+	if (l == 0)
+		return sqrt(QPointF::dotProduct(ap, ap));
+
+	qreal t = qMax(0.0, qMin(1.0, QPointF::dotProduct(ap, ab) / l));
+	QPointF d(ap - t * ab);
+	return sqrt(QPointF::dotProduct(d, d));
+}
+
+/* Douglas-Peucker tolerance (in meters) up to which the segment point is
+   part of the simplified segment. A point is never more significant than
+   the point that split its range, so any tolerance gives a valid DP
+   simplification. The segment end points are always part of the segment. */
+static QVector<qreal> significance(const PathSegment &segment)
+{
+	struct Range {
+		Range() : first(0), last(0), max(0) {}
+		Range(int first, int last, qreal max)
+		  : first(first), last(last), max(max) {}
+
+		int first, last;
+		qreal max;
+	};
+
+	int n = segment.size();
+	QVector<qreal> sig(n, 0);
+	QVector<QPointF> p(n);
+	QVector<Range> stack;
+
+	// Local equirectangular projection of the segment
+	qreal k = cos(deg2rad(segment.at(n/2).coordinates().lat()));
+	for (int i = 0; i < n; i++) {
+		const Coordinates &c = segment.at(i).coordinates();
+		p[i] = QPointF(deg2rad(c.lon()) * k, deg2rad(c.lat())) * WGS84_RADIUS;
+	}
+
+	sig[0] = INFINITY;
+	sig[n-1] = INFINITY;
+	stack.append(Range(0, n - 1, INFINITY));
+
+	while (!stack.isEmpty()) {
+		Range r(stack.takeLast());
+		if (r.last - r.first < 2)
+			continue;
+
+		int max = r.first + 1;
+		qreal dmax = -1;
+		for (int i = r.first + 1; i < r.last; i++) {
+			qreal d = distance(p.at(i), p.at(r.first), p.at(r.last));
+			if (d > dmax) {
+				dmax = d;
+				max = i;
+			}
+		}
+
+		sig[max] = qMin(dmax, r.max);
+		stack.append(Range(r.first, max, sig.at(max)));
+		stack.append(Range(max, r.last, sig.at(max)));
+	}
+
+	return sig;
+}
+
 Units PathItem::_units = Metric;
 QTimeZone PathItem::_timeZone = QTimeZone::utc();
 
@@ -45,6 +114,11 @@ PathItem::PathItem(const Path &path, Map *map, QGraphicsItem *parent)
 	_showTicks = false;
 	_markerInfoType = MarkerInfoItem::None;
 
+	_bounds = _path.boundingRect();
+	_significance.reserve(_path.size());
+	for (int i = 0; i < _path.size(); i++)
+		_significance.append(significance(_path.at(i)));
+
 	updatePainterPath();
 	updateShape();
 	updateTicks();
@@ -93,17 +167,31 @@ void PathItem::addSegment(const Coordinates &c1, const Coordinates &c2)
 		_painterPath.lineTo(_map->ll2xy(c2));
 }
 
+/* The path is drawn simplified to the current map resolution, so the painter
+   path (and its stroke) size depends on the on-screen size of the path rather
+   than on the number of the path points. */
 void PathItem::updatePainterPath()
 {
+	QRectF br(_map->ll2xy(_bounds.topLeft()),
+	  _map->ll2xy(_bounds.bottomRight()));
+	qreal tolerance = _map->resolution(br) * pow(2, -_digitalZoom) * TOLERANCE;
+
 	_painterPath = QPainterPath();
 
 	for (int i = 0; i < _path.size(); i++) {
 		const PathSegment &segment = _path.at(i);
+		const QVector<qreal> &sig = _significance.at(i);
+		int prev = 0;
+
 		_painterPath.moveTo(_map->ll2xy(segment.first().coordinates()));
 
 		for (int j = 1; j < segment.size(); j++) {
-			const PathPoint &p1 = segment.at(j-1);
+			if (sig.at(j) < tolerance)
+				continue;
+
+			const PathPoint &p1 = segment.at(prev);
 			const PathPoint &p2 = segment.at(j);
+			prev = j;
 			unsigned n = segments(p2.distance() - p1.distance());
 
 			if (n > 1) {
@@ -199,6 +287,7 @@ void PathItem::setDigitalZoom(int zoom)
 	for (int i = 0; i < _ticks.size(); i++)
 		_ticks.at(i)->setDigitalZoom(zoom);
 
+	updatePainterPath();
 	updateShape();
 }
 
@@ -416,6 +505,12 @@ void PathItem::addGraph(GraphItem *graph)
 	}
 }
 
+void PathItem::clearGraphs()
+{
+	_graphs.clear();
+	_graph = 0;
+}
+
 void PathItem::setGraph(int index)
 {
 	_graph = _graphs.at(index);
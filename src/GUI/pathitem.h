@@ -32,6 +32,7 @@ public:
 	const Path &path() const {return _path;}
 
 	void addGraph(GraphItem *graph);
+	void clearGraphs();
 
 	void setMap(Map *map);
 	void setGraph(int index);
@@ -81,6 +82,8 @@ private:
 	unsigned tickSize() const;
 
 	Path _path;
+	RectC _bounds;
+	QVector<QVector<qreal> > _significance;
 	Map *_map;
 	QList<GraphItem *> _graphs;
 	GraphItem *_graph;
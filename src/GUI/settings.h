@@ -179,6 +179,8 @@
 #define ENABLE_HTTP2_DEFAULT              true
 #define PIXMAP_CACHE_SETTING              "pixmapCache"
 #define PIXMAP_CACHE_DEFAULT              256 /* MB */
+#define RENDER_CACHE_SETTING              "renderCache"
+#define RENDER_CACHE_DEFAULT              0   /* MB */
 #define CONNECTION_TIMEOUT_SETTING        "connectionTimeout"
 #define CONNECTION_TIMEOUT_DEFAULT        30 /* s */
 #define HIRES_PRINT_SETTING               "hiresPrint"
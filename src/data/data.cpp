@@ -2,6 +2,8 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QLineF>
+#include <QThreadStorage>
+#include <QXmlStreamReader>
 #include "gpxparser.h"
 #include "tcxparser.h"
 #include "csvparser.h"
@@ -23,60 +25,140 @@
 #include "data.h"
 
 
-static GPXParser gpx;
-static TCXParser tcx;
-static KMLParser kml;
-static FITParser fit;
-static CSVParser csv;
-static IGCParser igc;
-static NMEAParser nmea;
-static PLTParser plt;
-static WPTParser wpt;
-static RTEParser rte;
-static LOCParser loc;
-static SLFParser slf;
-static GeoJSONParser geojson;
-static EXIFParser exif;
-static CUPParser cup;
-static GPIParser gpi;
-static SMLParser sml;
-static OV2Parser ov2;
-static ITNParser itn;
-static OMDParser omd;
-static GHPParser ghp;
-
-static QMap<QString, Parser*> parsers()
+/* The parsers keep the parsing state in their members, so every thread
+   loading the data files uses its own set of parser instances. */
+class Parsers
 {
-	QMap<QString, Parser*> map;
-
-	map.insert("gpx", &gpx);
-	map.insert("tcx", &tcx);
-	map.insert("kml", &kml);
-	map.insert("fit", &fit);
-	map.insert("csv", &csv);
-	map.insert("igc", &igc);
-	map.insert("nmea", &nmea);
-	map.insert("plt", &plt);
-	map.insert("wpt", &wpt);
-	map.insert("rte", &rte);
-	map.insert("loc", &loc);
-	map.insert("slf", &slf);
-	map.insert("json", &geojson);
-	map.insert("geojson", &geojson);
-	map.insert("jpeg", &exif);
-	map.insert("jpg", &exif);
-	map.insert("cup", &cup);
-	map.insert("gpi", &gpi);
-	map.insert("sml", &sml);
-	map.insert("ov2", &ov2);
-	map.insert("itn", &itn);
-	map.insert("omd", &omd);
-	map.insert("ghp", &ghp);
-
-	return map;
+public:
+	Parsers();
+
+	const QMap<QString, Parser*> &map() const {return _map;}
+
+private:
+	QMap<QString, Parser*> _map;
+
+	GPXParser _gpx;
+	TCXParser _tcx;
+	KMLParser _kml;
+	FITParser _fit;
+	CSVParser _csv;
+	IGCParser _igc;
+	NMEAParser _nmea;
+	PLTParser _plt;
+	WPTParser _wpt;
+	RTEParser _rte;
+	LOCParser _loc;
+	SLFParser _slf;
+	GeoJSONParser _geojson;
+	EXIFParser _exif;
+	CUPParser _cup;
+	GPIParser _gpi;
+	SMLParser _sml;
+	OV2Parser _ov2;
+	ITNParser _itn;
+	OMDParser _omd;
+	GHPParser _ghp;
+};
+
+Parsers::Parsers()
+{
+	_map.insert("gpx", &_gpx);
+	_map.insert("tcx", &_tcx);
+	_map.insert("kml", &_kml);
+	_map.insert("fit", &_fit);
+	_map.insert("csv", &_csv);
+	_map.insert("igc", &_igc);
+	_map.insert("nmea", &_nmea);
+	_map.insert("plt", &_plt);
+	_map.insert("wpt", &_wpt);
+	_map.insert("rte", &_rte);
+	_map.insert("loc", &_loc);
+	_map.insert("slf", &_slf);
+	_map.insert("json", &_geojson);
+	_map.insert("geojson", &_geojson);
+	_map.insert("jpeg", &_exif);
+	_map.insert("jpg", &_exif);
+	_map.insert("cup", &_cup);
+	_map.insert("gpi", &_gpi);
+	_map.insert("sml", &_sml);
+	_map.insert("ov2", &_ov2);
+	_map.insert("itn", &_itn);
+	_map.insert("omd", &_omd);
+	_map.insert("ghp", &_ghp);
+}
+
+static QThreadStorage<Parsers*> storage;
+
+static const QMap<QString, Parser*> &threadParsers()
+{
+	if (!storage.hasLocalData())
+		storage.setLocalData(new Parsers());
+
+	return storage.localData()->map();
+}
+
+#define SNIFF_SIZE 4096
+
+static bool isNMEA(const QByteArray &data)
+{
+	if (data.size() < 7 || data.at(0) != '$' || data.at(6) != ',')
+		return false;
+	for (int i = 1; i < 6; i++)
+		if (!(data.at(i) >= 'A' && data.at(i) <= 'Z'))
+			return false;
+
+	return true;
 }
 
-QMap<QString, Parser*> Data::_parsers = parsers();
+/* Detects the file format from the first few kB of the file. Only formats
+   with reliable signatures are detected, the parser key is returned or an
+   empty string if the format could not be detected. */
+static QString sniff(QFile *file)
+{
+	QByteArray data(file->peek(SNIFF_SIZE));
+
+	if (data.mid(8, 4) == ".FIT")
+		return "fit";
+	if (data.left(16).contains("GRMREC"))
+		return "gpi";
+	if (data.startsWith("\xFF\xD8"))
+		return "jpg";
+
+	if (data.startsWith("\xEF\xBB\xBF"))
+		data.remove(0, 3);
+	QByteArray text(data.trimmed());
+
+	if (text.startsWith("OziExplorer Track Point File"))
+		return "plt";
+	if (text.startsWith("OziExplorer Route File"))
+		return "rte";
+	if (text.startsWith("OziExplorer Waypoint File"))
+		return "wpt";
+	if (isNMEA(text))
+		return "nmea";
+	if (text.startsWith('{'))
+		return "geojson";
+
+	if (text.startsWith('<')) {
+		QXmlStreamReader reader(data);
+		if (reader.readNextStartElement()) {
+			if (reader.name() == QLatin1String("gpx"))
+				return "gpx";
+			else if (reader.name() == QLatin1String("TrainingCenterDatabase"))
+				return "tcx";
+			else if (reader.name() == QLatin1String("kml"))
+				return "kml";
+			else if (reader.name() == QLatin1String("Activity"))
+				return "slf";
+			else if (reader.name() == QLatin1String("sml"))
+				return "sml";
+			else if (reader.name() == QLatin1String("loc"))
+				return "loc";
+		}
+	}
+
+	return QString();
+}
 
 void Data::processData(QList<TrackData> &trackData, QList<RouteData> &routeData)
 {
@@ -101,8 +183,13 @@ Data::Data(const QString &fileName, bool tryUnknown)
 		return;
 	}
 
-	QMap<QString, Parser*>::iterator it;
-	if ((it = _parsers.find(fi.suffix().toLower())) != _parsers.end()) {
+	/* Files with an unknown suffix are parsed using the parser matching the
+	   file content. Only when the content is not recognized, all the parsers
+	   are tried. */
+	const QMap<QString, Parser*> &parsers = threadParsers();
+	QMap<QString, Parser*>::const_iterator it;
+	if ((it = parsers.find(fi.suffix().toLower())) != parsers.end()
+	  || (tryUnknown && (it = parsers.find(sniff(&file))) != parsers.end())) {
 		if (it.value()->parse(&file, trackData, routeData, _polygons,
 		  _waypoints)) {
 			processData(trackData, routeData);
@@ -113,7 +200,7 @@ Data::Data(const QString &fileName, bool tryUnknown)
 			_errorString = it.value()->errorString();
 		}
 	} else if (tryUnknown) {
-		for (it = _parsers.begin(); it != _parsers.end(); it++) {
+		for (it = parsers.begin(); it != parsers.end(); it++) {
 			if (it.value()->parse(&file, trackData, routeData, _polygons,
 			  _waypoints)) {
 				processData(trackData, routeData);
@@ -124,7 +211,7 @@ Data::Data(const QString &fileName, bool tryUnknown)
 		}
 
 		qWarning("Error loading data file: %s:", qPrintable(fileName));
-		for (it = _parsers.begin(); it != _parsers.end(); it++)
+		for (it = parsers.begin(); it != parsers.end(); it++)
 			qWarning("%s: line %d: %s", qPrintable(it.key()),
 			  it.value()->errorLine(), qPrintable(it.value()->errorString()));
 
@@ -160,10 +247,11 @@ QString Data::formats()
 
 QStringList Data::filter()
 {
+	const QMap<QString, Parser*> &parsers = threadParsers();
 	QStringList filter;
 
-	for (QMap<QString, Parser*>::iterator it = _parsers.begin();
-	  it != _parsers.end(); it++)
+	for (QMap<QString, Parser*>::const_iterator it = parsers.begin();
+	  it != parsers.end(); it++)
 		filter << "*." + it.key();
 
 	return filter;
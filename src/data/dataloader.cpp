@@ -0,0 +1,105 @@
+#include <QRunnable>
+#include "data.h"
+#include "dataloader.h"
+
+
+class DataLoader::Task : public QRunnable
+{
+public:
+	Task(DataLoader *loader, int generation, const QString &fileName)
+	  : _loader(loader), _generation(generation), _fileName(fileName) {}
+
+	void run()
+	{
+		_loader->report(_generation, _fileName, new Data(_fileName));
+	}
+
+private:
+	DataLoader *_loader;
+	int _generation;
+	QString _fileName;
+};
+
+
+DataLoader::DataLoader(QObject *parent)
+  : QObject(parent), _generation(0), _loaded(0), _total(0)
+{
+}
+
+DataLoader::~DataLoader()
+{
+	/* The tasks access the loader, so they must not outlive it */
+	cancel();
+	_pool.waitForDone();
+}
+
+void DataLoader::load(const QStringList &files)
+{
+	_total += files.size();
+
+	for (int i = 0; i < files.size(); i++)
+		_pool.start(new Task(this, _generation, files.at(i)));
+}
+
+/* Tasks that have not been started yet are removed from the pool, the
+   results of the running tasks are dropped once they finish. */
+void DataLoader::cancel()
+{
+	_pool.clear();
+
+	QMutexLocker locker(&_lock);
+	_generation++;
+	for (int i = 0; i < _queue.size(); i++)
+		delete _queue.at(i).second;
+	_queue.clear();
+
+	_loaded = 0;
+	_total = 0;
+}
+
+void DataLoader::report(int generation, const QString &fileName, Data *data)
+{
+	QMutexLocker locker(&_lock);
+
+	if (generation != _generation) {
+		delete data;
+		return;
+	}
+
+	/* All the files loaded until the GUI thread gets to the queue are handed
+	   over as a single batch */
+	if (_queue.isEmpty())
+		QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+	_queue.append(QPair<QString, Data*>(fileName, data));
+}
+
+void DataLoader::flush()
+{
+	_lock.lock();
+	QList<QPair<QString, Data*> > batch(_queue);
+	_queue.clear();
+	int generation = _generation;
+	_lock.unlock();
+
+	if (batch.isEmpty())
+		return;
+
+	for (int i = 0; i < batch.size(); i++) {
+		const QPair<QString, Data*> &item = batch.at(i);
+		/* The loading may get canceled by a loaded() signal receiver */
+		if (generation == _generation)
+			emit loaded(item.first, *item.second);
+		delete item.second;
+	}
+	if (generation != _generation)
+		return;
+
+	_loaded += batch.size();
+	emit progress(_loaded, _total);
+
+	if (_loaded == _total) {
+		_loaded = 0;
+		_total = 0;
+		emit finished();
+	}
+}
@@ -0,0 +1,49 @@
+#ifndef DATALOADER_H
+#define DATALOADER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QMutex>
+#include <QStringList>
+#include <QPair>
+
+class Data;
+
+/* Loads data files in a pool of background threads (at most one thread per
+   CPU core). The files are handed over to the GUI thread in batches in the
+   order they have been loaded, loaded() is emitted for every file of the
+   batch followed by a single progress() signal for the whole batch. */
+class DataLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	DataLoader(QObject *parent = 0);
+	~DataLoader();
+
+	void load(const QStringList &files);
+	void cancel();
+
+	bool isRunning() const {return (_total > 0);}
+
+signals:
+	void loaded(const QString &fileName, const Data &data);
+	void progress(int loaded, int total);
+	void finished();
+
+private slots:
+	void flush();
+
+private:
+	class Task;
+
+	void report(int generation, const QString &fileName, Data *data);
+
+	QThreadPool _pool;
+	QMutex _lock;
+	QList<QPair<QString, Data*> > _queue;
+	int _generation;
+	int _loaded, _total;
+};
+
+#endif // DATALOADER_H
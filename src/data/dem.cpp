@@ -15,8 +15,12 @@
 #include <QtMath>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QCryptographicHash>
 #include <private/qzipreader_p.h>
 #include "common/coordinates.h"
+#include "common/programpaths.h"
 #include "dem.h"
 
 
@@ -26,6 +30,9 @@
 #define SRTM_SIZE(samples) \
 	((samples) * (samples) * 2)
 
+#define CACHE_DIR  "dem"
+#define CACHE_SIZE (256 * 1024) /* kB */
+
 static qreal interpolate(qreal dx, qreal dy, qreal p0, qreal p1, qreal p2,
   qreal p3)
 {
@@ -33,41 +40,97 @@ static qreal interpolate(qreal dx, qreal dy, qreal p0, qreal p1, qreal p2,
 	  + p3 * dx * dy;
 }
 
-static qreal value(int col, int row, int samples, const QByteArray *data)
+static int samples(qint64 size)
 {
-	int pos = ((samples - 1 - row) * samples + col) * 2;
-	qint16 val = qFromBigEndian(*((const qint16*)(data->constData() + pos)));
+	if (size == SRTM_SIZE(SRTM3_SAMPLES))
+		return SRTM3_SAMPLES;
+	else if (size == SRTM_SIZE(SRTM1_SAMPLES))
+		return SRTM1_SAMPLES;
+	else
+		return 0;
+}
+
+static inline qreal value(const uchar *data)
+{
+	qint16 val = qFromBigEndian<qint16>(data);
 
 	return (val == -32768) ? NAN : val;
 }
 
-static qreal height(const Coordinates &c, const QByteArray *data)
+/* Bilinear interpolation of the elevations of count points lying in the tile
+   with the (lon, lat) bottom-left corner. The tile rows are stored from north
+   to south. */
+static void heights(const Coordinates *c, int count, int lon, int lat,
+  const uchar *data, qint64 size, qreal *ele)
 {
-	int samples;
+	int s = samples(size);
+	if (!s) {
+		for (int i = 0; i < count; i++)
+			ele[i] = NAN;
+		return;
+	}
+
+	qreal scale = s - 1;
+	int stride = s * 2;
+	const uchar *bottom = data + (s - 1) * stride;
+
+	for (int i = 0; i < count; i++) {
+		qreal x = (c[i].lon() - lon) * scale;
+		qreal y = (c[i].lat() - lat) * scale;
+		int col = (int)x;
+		int row = (int)y;
+		const uchar *p = bottom - row * stride + col * 2;
+
+		ele[i] = interpolate(x - col, y - row, value(p), value(p + 2),
+		  value(p - stride), value(p - stride + 2));
+	}
+}
+
+static bool save(const QString &fileName, const QByteArray &data)
+{
+	QSaveFile file(fileName);
+
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+	if (file.write(data) != data.size())
+		return false;
+
+	return file.commit();
+}
 
-	if (data->size() == SRTM_SIZE(SRTM3_SAMPLES))
-		samples = SRTM3_SAMPLES;
-	else if (data->size() == SRTM_SIZE(SRTM1_SAMPLES))
-		samples = SRTM1_SAMPLES;
-	else
-		return NAN;
 
-	int row = (int)((c.lat() - qFloor(c.lat())) * (samples - 1));
-	int col = (int)((c.lon() - qFloor(c.lon())) * (samples - 1));
-	qreal dx = ((c.lon() - qFloor(c.lon())) * (samples - 1)) - col;
-	qreal dy = ((c.lat() - qFloor(c.lat())) * (samples - 1)) - row;
+DEM::Tile::Tile(const QString &fileName)
+  : _file(fileName), _data(0), _size(0)
+{
+	if (!_file.open(QIODevice::ReadOnly)) {
+		qWarning("%s: %s", qPrintable(fileName),
+		  qPrintable(_file.errorString()));
+		return;
+	}
 
-	qreal p0 = value(col, row, samples, data);
-	qreal p1 = value(col + 1, row, samples, data);
-	qreal p2 = value(col, row + 1, samples, data);
-	qreal p3 = value(col + 1, row + 1, samples, data);
+	/* The mapping stays valid after the file is closed, it is unmapped
+	   when the QFile object is destroyed */
+	_size = _file.size();
+	_data = _file.map(0, _size);
+	if (!_data) {
+		_buffer = _file.readAll();
+		_data = (const uchar*)_buffer.constData();
+		_size = _buffer.size();
+	}
 
-	return interpolate(dx, dy, p0, p1, p2, p3);
+	_file.close();
+}
+
+DEM::Tile::Tile(const QByteArray &data)
+  : _buffer(data), _data((const uchar*)_buffer.constData()),
+  _size(_buffer.size())
+{
 }
 
 
 QString DEM::_dir;
-QCache<DEM::Key, QByteArray> DEM::_data;
+QCache<DEM::Key, DEM::TilePtr> DEM::_data(CACHE_SIZE);
+QMutex DEM::_lock;
 
 QString DEM::baseName(const Key &key)
 {
@@ -79,49 +142,131 @@ QString DEM::baseName(const Key &key)
 	  .arg(qAbs(key.lon()), 3, 10, QChar('0'));
 }
 
-QString DEM::fileName(const QString &baseName)
+/* The extracted tiles are stored in a directory per source zip file (hash of
+   its path) and the zip file size and modification time are part of the file
+   name, so tiles of a different or changed zip file are never reused. */
+QString DEM::cacheFile(const QFileInfo &zip, const QString &baseName)
 {
-	return QDir(_dir).absoluteFilePath(baseName);
+	QByteArray id(QCryptographicHash::hash(zip.absoluteFilePath().toUtf8(),
+	  QCryptographicHash::Md5).toHex());
+	QString name(QString("%1-%2-%3.hgt").arg(QFileInfo(baseName)
+	  .completeBaseName(), QString::number(zip.size()),
+	  QString::number(zip.lastModified().toMSecsSinceEpoch())));
+
+	return QDir(QDir(ProgramPaths::tilesDir()).filePath(CACHE_DIR))
+	  .absoluteFilePath(QString::fromLatin1(id) + "/" + name);
+}
+
+/* Zipped tiles are decompressed once into the disk cache and then mapped
+   like the uncompressed files. */
+DEM::Tile *DEM::loadTile(const QString &dir, const Key &key)
+{
+	QString bn(baseName(key));
+	QString fn(QDir(dir).absoluteFilePath(bn));
+	QFileInfo zi(fn + ".zip");
+
+	if (zi.exists()) {
+		QString cf(cacheFile(zi, bn));
+		QFileInfo ci(cf);
+
+		if (!ci.exists()) {
+			QZipReader zip(zi.absoluteFilePath(), QIODevice::ReadOnly);
+			QByteArray ba(zip.fileData(bn));
+
+			if (!(QDir().mkpath(ci.absolutePath()) && save(cf, ba))) {
+				qWarning("%s: error writing DEM cache file", qPrintable(cf));
+				return new Tile(ba);
+			}
+
+			/* Remove the tiles extracted from the previous zip file versions */
+			QDir cd(ci.absolutePath());
+			QStringList old(cd.entryList(QStringList(QFileInfo(bn)
+			  .completeBaseName() + "-*.hgt"), QDir::Files));
+			for (int i = 0; i < old.size(); i++)
+				if (old.at(i) != ci.fileName())
+					cd.remove(old.at(i));
+		}
+
+		return new Tile(cf);
+	} else
+		return new Tile(fn);
 }
 
 void DEM::setDir(const QString &path)
 {
+	QMutexLocker locker(&_lock);
+
 	_dir = path;
+	_data.clear();
+}
+
+QString DEM::dir()
+{
+	QMutexLocker locker(&_lock);
+	return _dir;
+}
+
+/* The tiles are loaded outside of the lock, so the slow file I/O does not
+   block the other queries. When two threads load the same tile at the same
+   time, the first loaded instance wins. */
+DEM::TilePtr DEM::tile(const Key &key)
+{
+	QMutexLocker locker(&_lock);
+
+	TilePtr *tp = _data.object(key);
+	if (tp)
+		return *tp;
+	QString dir(_dir);
+	locker.unlock();
+
+	TilePtr t(loadTile(dir, key));
+
+	locker.relock();
+	if ((tp = _data.object(key)))
+		return *tp;
+	if (dir == _dir)
+		_data.insert(key, new TilePtr(t), qMax(t->size() / 1024, (qint64)1));
+
+	return t;
 }
 
 qreal DEM::elevation(const Coordinates &c)
 {
-	if (_dir.isEmpty())
+	if (dir().isEmpty())
 		return NAN;
 
 	Key k(qFloor(c.lon()), qFloor(c.lat()));
+	TilePtr t(tile(k));
+	qreal ele;
 
-	QByteArray *ba = _data[k];
-	if (!ba) {
-		QString bn(baseName(k));
-		QString fn(fileName(bn));
-		QString zn(fn + ".zip");
-
-		if (QFileInfo::exists(zn)) {
-			QZipReader zip(zn, QIODevice::ReadOnly);
-			ba = new QByteArray(zip.fileData(bn));
-			qreal ele = height(c, ba);
-			_data.insert(k, ba);
-			return ele;
-		} else {
-			QFile file(fn);
-			if (!file.open(QIODevice::ReadOnly)) {
-				qWarning("%s: %s", qPrintable(file.fileName()),
-				  qPrintable(file.errorString()));
-				_data.insert(k, new QByteArray());
-				return NAN;
-			} else {
-				ba = new QByteArray(file.readAll());
-				qreal ele = height(c, ba);
-				_data.insert(k, ba);
-				return ele;
-			}
-		}
-	} else
-		return height(c, ba);
+	heights(&c, 1, k.lon(), k.lat(), t->data(), t->size(), &ele);
+
+	return ele;
+}
+
+QVector<qreal> DEM::elevation(const QVector<Coordinates> &c)
+{
+	QVector<qreal> ele(c.size(), NAN);
+
+	if (dir().isEmpty())
+		return ele;
+
+	/* Track/route points are spatially coherent, so the points are processed
+	   in runs of consecutive points lying in the same tile. Every run costs
+	   a single tile lookup. */
+	for (int i = 0; i < c.size(); ) {
+		Key k(qFloor(c.at(i).lon()), qFloor(c.at(i).lat()));
+		int j = i + 1;
+		while (j < c.size() && Key(qFloor(c.at(j).lon()),
+		  qFloor(c.at(j).lat())) == k)
+			j++;
+
+		TilePtr t(tile(k));
+		heights(c.constData() + i, j - i, k.lon(), k.lat(), t->data(),
+		  t->size(), ele.data() + i);
+
+		i = j;
+	}
+
+	return ele;
 }
@@ -4,9 +4,14 @@
 #include <QString>
 #include <QCache>
 #include <QByteArray>
+#include <QVector>
+#include <QFile>
+#include <QMutex>
+#include <QSharedPointer>
 #include "common/config.h"
 
 class QString;
+class QFileInfo;
 class Coordinates;
 
 class DEM
@@ -28,15 +33,43 @@ private:
 		int _lon, _lat;
 	};
 
+	/* SRTM tile data. Uncompressed files are memory mapped, the data is only
+	   read into memory if the file can not be mapped. */
+	class Tile {
+	public:
+		Tile(const QString &fileName);
+		Tile(const QByteArray &data);
+
+		const uchar *data() const {return _data;}
+		qint64 size() const {return _size;}
+
+	private:
+		Q_DISABLE_COPY(Tile)
+
+		QFile _file;
+		QByteArray _buffer;
+		const uchar *_data;
+		qint64 _size;
+	};
+
+	typedef QSharedPointer<const Tile> TilePtr;
+
 	static QString baseName(const Key &key);
-	static QString fileName(const QString &baseName);
+	static QString cacheFile(const QFileInfo &zip, const QString &baseName);
+	static Tile *loadTile(const QString &dir, const Key &key);
+	static TilePtr tile(const Key &key);
+	static QString dir();
 
 	static QString _dir;
-	static QCache<Key, QByteArray> _data;
+	static QCache<Key, TilePtr> _data;
+	static QMutex _lock;
 
 public:
+	/* All the functions are thread-safe. The tiles are shared by the
+	   concurrent queries, the lock only guards the cache lookups. */
 	static void setDir(const QString &path);
 	static qreal elevation(const Coordinates &c);
+	static QVector<qreal> elevation(const QVector<Coordinates> &c);
 
 	friend HASH_T qHash(const Key &key);
 };
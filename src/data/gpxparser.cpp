@@ -219,8 +219,9 @@ void GPXParser::trackpoints(SegmentData &segment)
 {
 	while (_reader.readNextStartElement()) {
 		if (_reader.name() == QLatin1String("trkpt")) {
-			segment.append(Trackpoint(coordinates()));
-			trackpointData(segment.last());
+			Trackpoint t(coordinates());
+			trackpointData(t);
+			segment.append(t);
 		} else
 			_reader.skipCurrentElement();
 	}
@@ -150,11 +150,12 @@ bool KMLParser::lineCoordinates(SegmentData &segment)
 			if (!res)
 				return false;
 
-			segment.append(Trackpoint(Coordinates(val[0], val[1])));
-			if (!segment.last().coordinates().isValid())
+			Trackpoint t(Coordinates(val[0], val[1]));
+			if (!t.coordinates().isValid())
 				return false;
 			if (c == 2)
-				segment.last().setElevation(val[2]);
+				t.setElevation(val[2]);
+			segment.append(t);
 
 			while (cp->isSpace())
 				cp++;
@@ -311,7 +312,7 @@ void KMLParser::heartRate(SegmentData &segment, int start)
 	while (_reader.readNextStartElement()) {
 		if (_reader.name() == QLatin1String("value")) {
 			if (i < segment.size())
-				segment[i++].setHeartRate(number());
+				segment.setHeartRate(i++, number());
 			else {
 				_reader.raiseError(error);
 				return;
@@ -332,7 +333,7 @@ void KMLParser::cadence(SegmentData &segment, int start)
 	while (_reader.readNextStartElement()) {
 		if (_reader.name() == QLatin1String("value")) {
 			if (i < segment.size())
-				segment[i++].setCadence(number());
+				segment.setCadence(i++, number());
 			else {
 				_reader.raiseError(error);
 				return;
@@ -353,7 +354,7 @@ void KMLParser::speed(SegmentData &segment, int start)
 	while (_reader.readNextStartElement()) {
 		if (_reader.name() == QLatin1String("value")) {
 			if (i < segment.size())
-				segment[i++].setSpeed(number());
+				segment.setSpeed(i++, number());
 			else {
 				_reader.raiseError(error);
 				return;
@@ -374,7 +375,7 @@ void KMLParser::temperature(SegmentData &segment, int start)
 	while (_reader.readNextStartElement()) {
 		if (_reader.name() == QLatin1String("value")) {
 			if (i < segment.size())
-				segment[i++].setTemperature(number());
+				segment.setTemperature(i++, number());
 			else {
 				_reader.raiseError(error);
 				return;
@@ -427,17 +428,20 @@ void KMLParser::track(SegmentData &segment)
 
 	while (_reader.readNextStartElement()) {
 		if (_reader.name() == QLatin1String("when")) {
-			segment.append(Trackpoint());
-			segment.last().setTimestamp(time());
+			Trackpoint t;
+			t.setTimestamp(time());
+			segment.append(t);
 		} else if (_reader.name() == QLatin1String("coord")) {
 			if (i == segment.size()) {
 				_reader.raiseError(error);
 				return;
-			} else if (!coord(segment[i])) {
+			}
+			Trackpoint t(segment.at(i));
+			if (!coord(t)) {
 				_reader.raiseError("Invalid coordinates");
 				return;
 			}
-			i++;
+			segment.replace(i++, t);
 		} else if (_reader.name() == QLatin1String("ExtendedData"))
 			extendedData(segment, first);
 		else
@@ -282,7 +282,8 @@ bool NMEAParser::readRMC(CTX &ctx, const char *line, int len,
 
 	if (!date.isNull()) {
 		if (ctx.date.isNull() && !ctx.time.isNull() && !segment.isEmpty())
-			segment.last().setTimestamp(QDateTime(date, ctx.time, Qt::UTC));
+			segment.setTimestamp(segment.size() - 1, QDateTime(date, ctx.time,
+			  Qt::UTC));
 		ctx.date = date;
 	}
 
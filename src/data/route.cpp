@@ -47,11 +47,14 @@ Graph Route::demElevation() const
 	graph.append(GraphSegment());
 	GraphSegment &gs = graph.last();
 
-	for (int i = 0; i < _data.size(); i++) {
-		qreal dem = DEM::elevation(_data.at(i).coordinates());
-		if (!std::isnan(dem))
-			gs.append(GraphPoint(_distance.at(i), NAN, dem));
-	}
+	QVector<Coordinates> c(_data.size());
+	for (int i = 0; i < _data.size(); i++)
+		c[i] = _data.at(i).coordinates();
+	QVector<qreal> dem(DEM::elevation(c));
+
+	for (int i = 0; i < _data.size(); i++)
+		if (!std::isnan(dem.at(i)))
+			gs.append(GraphPoint(_distance.at(i), NAN, dem.at(i)));
 
 	return graph;
 }
@@ -0,0 +1,141 @@
+#include <limits>
+#include "common/wgs84.h"
+#include "segmentdata.h"
+
+
+const qint64 SegmentData::NO_TIME = std::numeric_limits<qint64>::min();
+
+qint64 SegmentData::msecs(const QDateTime &timestamp)
+{
+	return timestamp.isValid() ? timestamp.toMSecsSinceEpoch() : NO_TIME;
+}
+
+QDateTime SegmentData::timestamp(int i) const
+{
+	return (_time.at(i) == NO_TIME)
+	  ? QDateTime() : QDateTime::fromMSecsSinceEpoch(_time.at(i), Qt::UTC);
+}
+
+void SegmentData::reserve(int size)
+{
+	_lon.reserve(size);
+	_lat.reserve(size);
+	_time.reserve(size);
+}
+
+/* Must be called before the point is appended to the coordinates columns */
+void SegmentData::appendValue(Column column, qreal value)
+{
+	QVector<qreal> &c = _columns[column];
+
+	if (c.isEmpty()) {
+		if (std::isnan(value))
+			return;
+		c.fill(NAN, size());
+	}
+	c.append(value);
+}
+
+void SegmentData::setValue(Column column, int i, qreal value)
+{
+	QVector<qreal> &c = _columns[column];
+
+	if (c.isEmpty()) {
+		if (std::isnan(value))
+			return;
+		c.fill(NAN, size());
+	}
+	c[i] = value;
+}
+
+void SegmentData::append(const Trackpoint &trackpoint)
+{
+	appendValue(Elevation, trackpoint.elevation());
+	appendValue(Speed, trackpoint.speed());
+	appendValue(HeartRate, trackpoint.heartRate());
+	appendValue(Temperature, trackpoint.temperature());
+	appendValue(Cadence, trackpoint.cadence());
+	appendValue(Power, trackpoint.power());
+	appendValue(Ratio, trackpoint.ratio());
+
+	_lon.append(trackpoint.coordinates().lon());
+	_lat.append(trackpoint.coordinates().lat());
+	_time.append(msecs(trackpoint.timestamp()));
+}
+
+void SegmentData::append(const SegmentData &other)
+{
+	for (int i = 0; i < Columns; i++) {
+		QVector<qreal> &c = _columns[i];
+		const QVector<qreal> &oc = other._columns[i];
+
+		if (c.isEmpty() && oc.isEmpty())
+			continue;
+		if (c.isEmpty())
+			c.fill(NAN, size());
+		if (oc.isEmpty())
+			c.insert(c.size(), other.size(), NAN);
+		else
+			c << oc;
+	}
+
+	_lon << other._lon;
+	_lat << other._lat;
+	_time << other._time;
+}
+
+void SegmentData::replace(int i, const Trackpoint &trackpoint)
+{
+	setCoordinates(i, trackpoint.coordinates());
+	setTimestamp(i, trackpoint.timestamp());
+	setElevation(i, trackpoint.elevation());
+	setSpeed(i, trackpoint.speed());
+	setHeartRate(i, trackpoint.heartRate());
+	setTemperature(i, trackpoint.temperature());
+	setCadence(i, trackpoint.cadence());
+	setPower(i, trackpoint.power());
+	setRatio(i, trackpoint.ratio());
+}
+
+Trackpoint SegmentData::at(int i) const
+{
+	Trackpoint t(coordinates(i));
+
+	t.setTimestamp(timestamp(i));
+	t.setElevation(elevation(i));
+	t.setSpeed(speed(i));
+	t.setHeartRate(heartRate(i));
+	t.setTemperature(temperature(i));
+	t.setCadence(cadence(i));
+	t.setPower(power(i));
+	t.setRatio(ratio(i));
+
+	return t;
+}
+
+/* Haversine distances of the consecutive points, the first item is always
+   zero. Gives the same results as Coordinates::distanceTo() but computes
+   the latitude cosines only once per point and uses asin() instead of the
+   atan2() of the two square roots. */
+QVector<qreal> SegmentData::distances() const
+{
+	int n = size();
+	const double *lon = _lon.constData();
+	const double *lat = _lat.constData();
+	QVector<double> cosLat(n);
+	QVector<qreal> ret(n);
+
+	for (int i = 0; i < n; i++)
+		cosLat[i] = cos(deg2rad(lat[i]));
+
+	const double *c = cosLat.constData();
+	qreal *d = ret.data();
+	for (int i = 1; i < n; i++) {
+		double sLat = sin(deg2rad(lat[i] - lat[i-1]) / 2.0);
+		double sLon = sin(deg2rad(lon[i] - lon[i-1]) / 2.0);
+		double a = sLat * sLat + c[i-1] * c[i] * sLon * sLon;
+		d[i] = WGS84_RADIUS * 2.0 * (a > 1.0 ? M_PI_2 : asin(sqrt(a)));
+	}
+
+	return ret;
+}
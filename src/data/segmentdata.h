@@ -0,0 +1,99 @@
+#ifndef SEGMENTDATA_H
+#define SEGMENTDATA_H
+
+#include <QVector>
+#include <QDateTime>
+#include <cmath>
+#include "common/coordinates.h"
+#include "trackpoint.h"
+
+/* Track segment stored by columns. The coordinates and the timestamps
+   (milliseconds since epoch) are always present, the sensor columns are only
+   allocated once the first valid value is set. The parsers fill the segment
+   using trackpoints, Track works directly on the columns. */
+class SegmentData
+{
+public:
+	int size() const {return _lon.size();}
+	bool isEmpty() const {return _lon.isEmpty();}
+	void reserve(int size);
+
+	Trackpoint at(int i) const;
+	Trackpoint first() const {return at(0);}
+	Trackpoint last() const {return at(size() - 1);}
+
+	void append(const Trackpoint &trackpoint);
+	void append(const SegmentData &other);
+	void replace(int i, const Trackpoint &trackpoint);
+	SegmentData &operator<<(const SegmentData &other)
+	  {append(other); return *this;}
+
+	const QVector<double> &lon() const {return _lon;}
+	const QVector<double> &lat() const {return _lat;}
+	const QVector<qint64> &time() const {return _time;}
+
+	QVector<qreal> distances() const;
+
+	Coordinates coordinates(int i) const
+	  {return Coordinates(_lon.at(i), _lat.at(i));}
+	QDateTime timestamp(int i) const;
+	qreal elevation(int i) const {return value(Elevation, i);}
+	qreal speed(int i) const {return value(Speed, i);}
+	qreal heartRate(int i) const {return value(HeartRate, i);}
+	qreal temperature(int i) const {return value(Temperature, i);}
+	qreal cadence(int i) const {return value(Cadence, i);}
+	qreal power(int i) const {return value(Power, i);}
+	qreal ratio(int i) const {return value(Ratio, i);}
+
+	void setCoordinates(int i, const Coordinates &c)
+	  {_lon[i] = c.lon(); _lat[i] = c.lat();}
+	void setTimestamp(int i, const QDateTime &timestamp)
+	  {_time[i] = msecs(timestamp);}
+	void setElevation(int i, qreal elevation)
+	  {setValue(Elevation, i, elevation);}
+	void setSpeed(int i, qreal speed) {setValue(Speed, i, speed);}
+	void setHeartRate(int i, qreal heartRate)
+	  {setValue(HeartRate, i, heartRate);}
+	void setTemperature(int i, qreal temperature)
+	  {setValue(Temperature, i, temperature);}
+	void setCadence(int i, qreal cadence) {setValue(Cadence, i, cadence);}
+	void setPower(int i, qreal power) {setValue(Power, i, power);}
+	void setRatio(int i, qreal ratio) {setValue(Ratio, i, ratio);}
+
+	bool hasTimestamp(int i) const {return (_time.at(i) != NO_TIME);}
+	bool hasElevation(int i) const {return !std::isnan(elevation(i));}
+	bool hasSpeed(int i) const {return !std::isnan(speed(i));}
+	bool hasHeartRate(int i) const {return !std::isnan(heartRate(i));}
+	bool hasTemperature(int i) const {return !std::isnan(temperature(i));}
+	bool hasCadence(int i) const {return !std::isnan(cadence(i));}
+	bool hasPower(int i) const {return !std::isnan(power(i));}
+	bool hasRatio(int i) const {return !std::isnan(ratio(i));}
+
+	static const qint64 NO_TIME;
+
+private:
+	enum Column {
+		Elevation,
+		Speed,
+		HeartRate,
+		Temperature,
+		Cadence,
+		Power,
+		Ratio,
+		Columns
+	};
+
+	qreal value(Column column, int i) const
+	  {return _columns[column].isEmpty() ? NAN : _columns[column].at(i);}
+	void setValue(Column column, int i, qreal value);
+	void appendValue(Column column, qreal value);
+
+	static qint64 msecs(const QDateTime &timestamp);
+
+	QVector<double> _lon;
+	QVector<double> _lat;
+	QVector<qint64> _time;
+	QVector<qreal> _columns[Columns];
+};
+
+#endif // SEGMENTDATA_H
@@ -108,13 +108,13 @@ void SMLParser::samples(SegmentData &segment)
 	}
 
 	for (int i = 0; i < segment.size(); i++) {
-		Trackpoint &t = segment[i];
-		if ((it = sensors.lowerBound(t.timestamp())) != sensors.constEnd()) {
-			t.setCadence(it->cadence * 60);
-			t.setTemperature(it->temperature - 273.15);
-			t.setHeartRate(it->hr * 60);
-			t.setPower(it->power);
-			t.setSpeed(it->speed);
+		if ((it = sensors.lowerBound(segment.timestamp(i)))
+		  != sensors.constEnd()) {
+			segment.setCadence(i, it->cadence * 60);
+			segment.setTemperature(i, it->temperature - 273.15);
+			segment.setHeartRate(i, it->hr * 60);
+			segment.setPower(i, it->power);
+			segment.setSpeed(i, it->speed);
 		}
 	}
 }
@@ -18,6 +18,7 @@ bool Track::_useDEM = false;
 bool Track::_show2ndElevation = false;
 bool Track::_show2ndSpeed = false;
 bool Track::_useSegments = true;
+int Track::_version[SeriesCount] = {0};
 
 static qreal avg(const QVector<qreal> &v)
 {
@@ -109,6 +110,7 @@ Track::Track(const TrackData &data) : _pause(0)
 			continue;
 
 		// precompute distances, times, speeds and acceleration
+		QVector<qreal> dist(sd.distances());
 		QVector<qreal> acceleration;
 
 		Segment &seg = _segments.last();
@@ -117,23 +119,21 @@ Track::Track(const TrackData &data) : _pause(0)
 		  ? _segments.at(i-1).distance.last() : 0);
 		seg.time.append(i && !_segments.at(i-1).time.isEmpty()
 		  ? _segments.at(i-1).time.last() :
-		  sd.first().hasTimestamp() ? 0 : NAN);
-		seg.speed.append(sd.first().hasTimestamp() ? 0 : NAN);
-		acceleration.append(sd.first().hasTimestamp() ? 0 : NAN);
+		  sd.hasTimestamp(0) ? 0 : NAN);
+		seg.speed.append(sd.hasTimestamp(0) ? 0 : NAN);
+		acceleration.append(sd.hasTimestamp(0) ? 0 : NAN);
 		bool hasTime = !std::isnan(seg.time.first());
 
 		for (int j = 1; j < sd.size(); j++) {
-			ds = sd.at(j).coordinates().distanceTo(
-			  sd.at(j-1).coordinates());
+			ds = dist.at(j);
 			seg.distance.append(seg.distance.last() + ds);
 
-			if (hasTime && sd.at(j).timestamp().isValid()) {
-				if (sd.at(j).timestamp() > sd.at(j-1).timestamp())
-					dt = sd.at(j-1).timestamp().msecsTo(
-					  sd.at(j).timestamp()) / 1000.0;
+			if (hasTime && sd.hasTimestamp(j)) {
+				if (sd.time().at(j) > sd.time().at(j-1))
+					dt = (sd.time().at(j) - sd.time().at(j-1)) / 1000.0;
 				else {
 					qWarning("%s: %s: time skew detected", qPrintable(
-					  _data.name()), qPrintable(sd.at(j).timestamp().toString(
+					  _data.name()), qPrintable(sd.timestamp(j).toString(
 					  Qt::ISODate)));
 					dt = 0;
 				}
@@ -221,8 +221,8 @@ Track::Track(const TrackData &data) : _pause(0)
 				seg.distance[j] = seg.distance.at(last);
 				seg.speed[j] = 0;
 			} else {
-				ds = sd.at(j).coordinates().distanceTo(
-				  sd.at(last).coordinates());
+				ds = (last == j - 1) ? dist.at(j)
+				  : sd.coordinates(j).distanceTo(sd.coordinates(last));
 				seg.distance[j] = seg.distance.at(last) + ds;
 
 				dt = seg.time.at(j) - seg.time.at(last);
@@ -245,10 +245,10 @@ Graph Track::gpsElevation() const
 		GraphSegment gs;
 
 		for (int j = 0; j < sd.size(); j++) {
-			if (!sd.at(j).hasElevation() || seg.outliers.contains(j))
+			if (!sd.hasElevation(j) || seg.outliers.contains(j))
 				continue;
 			gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j),
-			  sd.at(j).elevation()));
+			  sd.elevation(j)));
 		}
 
 		ret.append(filter(gs, _elevationWindow));
@@ -267,12 +267,17 @@ Graph Track::demElevation() const
 			continue;
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs;
+		QVector<Coordinates> c(sd.size());
+
+		for (int j = 0; j < sd.size(); j++)
+			c[j] = sd.coordinates(j);
+		QVector<qreal> dem(DEM::elevation(c));
 
 		for (int j = 0; j < sd.size(); j++) {
-			qreal dem = DEM::elevation(sd.at(j).coordinates());
-			if (std::isnan(dem) || seg.outliers.contains(j))
+			if (std::isnan(dem.at(j)) || seg.outliers.contains(j))
 				continue;
-			gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j), dem));
+			gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j),
+			  dem.at(j)));
 		}
 
 		ret.append(filter(gs, _elevationWindow));
@@ -284,17 +289,19 @@ Graph Track::demElevation() const
 GraphPair Track::elevation() const
 {
 	if (_useDEM) {
-		Graph dem(demElevation());
+		const Graph &dem = graph(DEMElevation);
 		if (dem.isValid())
-			return GraphPair(dem, _show2ndElevation ? gpsElevation() : Graph());
+			return GraphPair(dem, _show2ndElevation ? graph(GPSElevation)
+			  : Graph());
 		else
-			return GraphPair(gpsElevation(), Graph());
+			return GraphPair(graph(GPSElevation), Graph());
 	} else {
-		Graph gps(gpsElevation());
+		const Graph &gps = graph(GPSElevation);
 		if (gps.isValid())
-			return GraphPair(gps, _show2ndElevation ? demElevation() : Graph());
+			return GraphPair(gps, _show2ndElevation ? graph(DEMElevation)
+			  : Graph());
 		else
-			return GraphPair(demElevation(), Graph());
+			return GraphPair(graph(DEMElevation), Graph());
 	}
 }
 
@@ -347,11 +354,11 @@ Graph Track::reportedSpeed() const
 		qreal v;
 
 		for (int j = 0; j < sd.size(); j++) {
-			if (seg.stop.contains(j) && sd.at(j).hasSpeed()) {
+			if (seg.stop.contains(j) && sd.hasSpeed(j)) {
 				v = 0;
 				stop.append(gs.size());
-			} else if (sd.at(j).hasSpeed() && !seg.outliers.contains(j))
-				v = sd.at(j).speed();
+			} else if (sd.hasSpeed(j) && !seg.outliers.contains(j))
+				v = sd.speed(j);
 			else
 				continue;
 
@@ -371,23 +378,23 @@ Graph Track::reportedSpeed() const
 GraphPair Track::speed() const
 {
 	if (_useReportedSpeed) {
-		Graph reported(reportedSpeed());
+		const Graph &reported = graph(ReportedSpeed);
 		if (reported.isValid())
-			return GraphPair(reported, _show2ndSpeed ? computedSpeed()
+			return GraphPair(reported, _show2ndSpeed ? graph(ComputedSpeed)
 			  : Graph());
 		else
-			return GraphPair(computedSpeed(), Graph());
+			return GraphPair(graph(ComputedSpeed), Graph());
 	} else {
-		Graph computed(computedSpeed());
+		const Graph &computed = graph(ComputedSpeed);
 		if (computed.isValid())
-			return GraphPair(computed, _show2ndSpeed ? reportedSpeed()
+			return GraphPair(computed, _show2ndSpeed ? graph(ReportedSpeed)
 			  : Graph());
 		else
-			return GraphPair(reportedSpeed(), Graph());
+			return GraphPair(graph(ReportedSpeed), Graph());
 	}
 }
 
-Graph Track::heartRate() const
+Graph Track::computeHeartRate() const
 {
 	Graph ret;
 
@@ -399,9 +406,9 @@ Graph Track::heartRate() const
 		GraphSegment gs;
 
 		for (int j = 0; j < sd.size(); j++)
-			if (sd.at(j).hasHeartRate() && !seg.outliers.contains(j))
+			if (sd.hasHeartRate(j) && !seg.outliers.contains(j))
 				gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j),
-				  sd.at(j).heartRate()));
+				  sd.heartRate(j)));
 
 		ret.append(filter(gs, _heartRateWindow));
 	}
@@ -409,7 +416,7 @@ Graph Track::heartRate() const
 	return ret;
 }
 
-Graph Track::temperature() const
+Graph Track::computeTemperature() const
 {
 	Graph ret;
 
@@ -420,10 +427,10 @@ Graph Track::temperature() const
 		const Segment &seg = _segments.at(i);
 		GraphSegment gs;
 
-		for (int j = 0; j < sd.count(); j++) {
-			if (sd.at(j).hasTemperature() && !seg.outliers.contains(j))
+		for (int j = 0; j < sd.size(); j++) {
+			if (sd.hasTemperature(j) && !seg.outliers.contains(j))
 				gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j),
-				  sd.at(j).temperature()));
+				  sd.temperature(j)));
 		}
 
 		ret.append(gs);
@@ -432,7 +439,7 @@ Graph Track::temperature() const
 	return ret;
 }
 
-Graph Track::ratio() const
+Graph Track::computeRatio() const
 {
 	Graph ret;
 
@@ -444,9 +451,9 @@ Graph Track::ratio() const
 		GraphSegment gs;
 
 		for (int j = 0; j < sd.size(); j++)
-			if (sd.at(j).hasRatio() && !seg.outliers.contains(j))
+			if (sd.hasRatio(j) && !seg.outliers.contains(j))
 				gs.append(GraphPoint(seg.distance.at(j), seg.time.at(j),
-				  sd.at(j).ratio()));
+				  sd.ratio(j)));
 
 		ret.append(gs);
 	}
@@ -454,7 +461,7 @@ Graph Track::ratio() const
 	return ret;
 }
 
-Graph Track::cadence() const
+Graph Track::computeCadence() const
 {
 	Graph ret;
 
@@ -468,11 +475,11 @@ Graph Track::cadence() const
 		qreal c;
 
 		for (int j = 0; j < sd.size(); j++) {
-			if (sd.at(j).hasCadence() && seg.stop.contains(j)) {
+			if (sd.hasCadence(j) && seg.stop.contains(j)) {
 				c = 0;
 				stop.append(gs.size());
-			} else if (sd.at(j).hasCadence() && !seg.outliers.contains(j))
-				c = sd.at(j).cadence();
+			} else if (sd.hasCadence(j) && !seg.outliers.contains(j))
+				c = sd.cadence(j);
 			else
 				continue;
 
@@ -489,7 +496,7 @@ Graph Track::cadence() const
 	return ret;
 }
 
-Graph Track::power() const
+Graph Track::computePower() const
 {
 	Graph ret;
 	QList<int> stop;
@@ -504,11 +511,11 @@ Graph Track::power() const
 		GraphSegment gs;
 
 		for (int j = 0; j < sd.size(); j++) {
-			if (sd.at(j).hasPower() && seg.stop.contains(j)) {
+			if (sd.hasPower(j) && seg.stop.contains(j)) {
 				p = 0;
 				stop.append(gs.size());
-			} else if (sd.at(j).hasPower() && !seg.outliers.contains(j))
-				p = sd.at(j).power();
+			} else if (sd.hasPower(j) && !seg.outliers.contains(j))
+				p = sd.power(j);
 			else
 				continue;
 
@@ -525,6 +532,42 @@ Graph Track::power() const
 	return ret;
 }
 
+Graph Track::computeGraph(Series series) const
+{
+	switch (series) {
+		case GPSElevation:
+			return gpsElevation();
+		case DEMElevation:
+			return demElevation();
+		case ReportedSpeed:
+			return reportedSpeed();
+		case ComputedSpeed:
+			return computedSpeed();
+		case HeartRate:
+			return computeHeartRate();
+		case Temperature:
+			return computeTemperature();
+		case Cadence:
+			return computeCadence();
+		case Power:
+			return computePower();
+		case Ratio:
+			return computeRatio();
+		default:
+			return Graph();
+	}
+}
+
+const Graph &Track::graph(Series series) const
+{
+	if (_cache.version[series] != _version[series]) {
+		_cache.graphs[series] = computeGraph(series);
+		_cache.version[series] = _version[series];
+	}
+
+	return _cache.graphs[series];
+}
+
 qreal Track::distance() const
 {
 	for (int i = _segments.size() - 1; i >= 0; i--) {
@@ -559,7 +602,7 @@ qreal Track::movingTime() const
 QDateTime Track::date() const
 {
 	return (_data.size() && _data.first().size())
-	  ? _data.first().first().timestamp() : QDateTime();
+	  ? _data.first().timestamp(0) : QDateTime();
 }
 
 Path Track::path() const
@@ -576,7 +619,7 @@ Path Track::path() const
 
 		for (int j = 0; j < sd.size(); j++)
 			if (!seg.outliers.contains(j) && !discardStopPoint(seg, j))
-				ps.append(PathPoint(sd.at(j).coordinates(),
+				ps.append(PathPoint(sd.coordinates(j),
 				  seg.distance.at(j)));
 	}
 
@@ -19,11 +19,11 @@ public:
 
 	GraphPair elevation() const;
 	GraphPair speed() const;
-	Graph heartRate() const;
-	Graph temperature() const;
-	Graph cadence() const;
-	Graph power() const;
-	Graph ratio() const;
+	Graph heartRate() const {return graph(HeartRate);}
+	Graph temperature() const {return graph(Temperature);}
+	Graph cadence() const {return graph(Cadence);}
+	Graph power() const {return graph(Power);}
+	Graph ratio() const {return graph(Ratio);}
 
 	qreal distance() const;
 	qreal time() const;
@@ -37,11 +37,18 @@ public:
 
 	bool isValid() const;
 
-	static void setElevationFilter(int window) {_elevationWindow = window;}
-	static void setSpeedFilter(int window) {_speedWindow = window;}
-	static void setHeartRateFilter(int window) {_heartRateWindow = window;}
-	static void setCadenceFilter(int window) {_cadenceWindow = window;}
-	static void setPowerFilter(int window) {_powerWindow = window;}
+	static void setElevationFilter(int window)
+	  {_elevationWindow = window; invalidate(GPSElevation);
+	  invalidate(DEMElevation);}
+	static void setSpeedFilter(int window)
+	  {_speedWindow = window; invalidate(ReportedSpeed);
+	  invalidate(ComputedSpeed);}
+	static void setHeartRateFilter(int window)
+	  {_heartRateWindow = window; invalidate(HeartRate);}
+	static void setCadenceFilter(int window)
+	  {_cadenceWindow = window; invalidate(Cadence);}
+	static void setPowerFilter(int window)
+	  {_powerWindow = window; invalidate(Power);}
 	static void setAutomaticPause(bool set) {_automaticPause = set;}
 	static void setPauseSpeed(qreal speed) {_pauseSpeed = speed;}
 	static void setPauseInterval(int interval) {_pauseInterval = interval;}
@@ -62,16 +69,50 @@ private:
 		QSet<int> stop;
 	};
 
+	enum Series {
+		GPSElevation,
+		DEMElevation,
+		ReportedSpeed,
+		ComputedSpeed,
+		HeartRate,
+		Temperature,
+		Cadence,
+		Power,
+		Ratio,
+		SeriesCount
+	};
+
+	/* The graphs are computed on the first access and kept until the filter
+	   setting of the series changes (the static series version changes).
+	   Not thread-safe, the graphs are only accessed from the GUI thread. */
+	struct Cache {
+		Cache() {for (int i = 0; i < SeriesCount; i++) version[i] = -1;}
+
+		int version[SeriesCount];
+		Graph graphs[SeriesCount];
+	};
+
+	static void invalidate(Series series) {_version[series]++;}
+
 	bool discardStopPoint(const Segment &seg, int i) const;
 
+	const Graph &graph(Series series) const;
+	Graph computeGraph(Series series) const;
+
 	Graph demElevation() const;
 	Graph gpsElevation() const;
 	Graph reportedSpeed() const;
 	Graph computedSpeed() const;
+	Graph computeHeartRate() const;
+	Graph computeTemperature() const;
+	Graph computeCadence() const;
+	Graph computePower() const;
+	Graph computeRatio() const;
 
 	TrackData _data;
 	QList<Segment> _segments;
 	qreal _pause;
+	mutable Cache _cache;
 
 	static bool _outlierEliminate;
 	static int _elevationWindow;
@@ -87,6 +128,7 @@ private:
 	static bool _show2ndElevation;
 	static bool _show2ndSpeed;
 	static bool _useSegments;
+	static int _version[SeriesCount];
 };
 
 #endif // TRACK_H
@@ -181,19 +181,19 @@ bool IMGData::createTileTree(const TileMap &tileMap)
 	return (_tileTree.Count() > 0);
 }
 
-IMGData::IMGData(const QString &fileName) : _fileName(fileName)
+IMGData::IMGData(const QString &fileName)
+  : _fileName(fileName), _file(fileName), _map(0), _mapSize(0)
 {
-	QFile file(fileName);
 	TileMap tileMap;
 
-	if (!file.open(QFile::ReadOnly)) {
-		_errorString = file.errorString();
+	if (!_file.open(QFile::ReadOnly)) {
+		_errorString = _file.errorString();
 		return;
 	}
 
-	if (!readIMGHeader(file))
+	if (!readIMGHeader(_file))
 		return;
-	if (!readFAT(file, tileMap)) {
+	if (!readFAT(_file, tileMap)) {
 		_errorString = "Error reading FAT data";
 		qDeleteAll(tileMap);
 		return;
@@ -203,9 +203,34 @@ IMGData::IMGData(const QString &fileName) : _fileName(fileName)
 		return;
 	}
 
+	mapFile();
+
 	_valid = true;
 }
 
+IMGData::~IMGData()
+{
+	if (_map)
+		_file.unmap(_map);
+}
+
+void IMGData::mapFile()
+{
+	/* XORed files must be decoded, so only the plain ones can be accessed
+	   directly. If the mapping fails, the blocks are read using the
+	   handles' files. */
+	if (_key)
+		_file.close();
+	else {
+		_mapSize = _file.size();
+		_map = _file.map(0, _mapSize);
+		if (!_map) {
+			_mapSize = 0;
+			_file.close();
+		}
+	}
+}
+
 qint64 IMGData::read(QFile &file, char *data, qint64 maxSize) const
 {
 	qint64 ret = file.read(data, maxSize);
@@ -1,22 +1,30 @@
 #ifndef IMG_IMGDATA_H
 #define IMG_IMGDATA_H
 
+#include <QFile>
 #include "mapdata.h"
 
-class QFile;
-
 namespace IMG {
 
 class IMGData : public MapData
 {
 public:
 	IMGData(const QString &fileName);
+	~IMGData();
 
 	const QString &fileName() const {return _fileName;}
 
 	unsigned blockBits() const {return _blockBits;}
 	bool readBlock(QFile &file, int blockNum, char *data) const;
 
+	bool isMapped() const {return (_map != 0);}
+	const char *block(int blockNum) const
+	{
+		quint64 offset = (quint64)blockNum << _blockBits;
+		return (offset + (1ULL<<_blockBits) <= _mapSize)
+		  ? (const char*)_map + offset : 0;
+	}
+
 private:
 	typedef QMap<QByteArray, VectorTile*> TileMap;
 
@@ -26,10 +34,15 @@ private:
 	bool readFAT(QFile &file, TileMap &tileMap);
 	bool readIMGHeader(QFile &file);
 	bool createTileTree(const TileMap &tileMap);
+	void mapFile();
 
 	QString _fileName;
 	quint8 _key;
 	unsigned _blockBits;
+
+	QFile _file;
+	uchar *_map;
+	quint64 _mapSize;
 };
 
 }
@@ -26,10 +26,9 @@ bool MapData::pointCb(VectorTile *tile, void *context)
 
 
 MapData::MapData() : _typ(0), _style(0), _zooms(24, 28), _baseMap(false),
-  _valid(false)
+  _valid(false), _polyCache(CACHED_SUBDIVS_COUNT),
+  _pointCache(CACHED_SUBDIVS_COUNT)
 {
-	_polyCache.setMaxCost(CACHED_SUBDIVS_COUNT);
-	_pointCache.setMaxCost(CACHED_SUBDIVS_COUNT);
 }
 
 MapData::~MapData()
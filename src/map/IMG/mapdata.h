@@ -3,13 +3,13 @@
 
 #include <QList>
 #include <QPointF>
-#include <QCache>
 #include <QDebug>
 #include "common/rectc.h"
 #include "common/rtree.h"
 #include "common/range.h"
 #include "label.h"
 #include "raster.h"
+#include "subdivcache.h"
 
 
 namespace IMG {
@@ -56,6 +56,7 @@ public:
 	const RectC &bounds() const {return _bounds;}
 	const Range &zooms() const {return _zooms;}
 	const Style *style() const {return _style;}
+	/* polys() and points() may be called concurrently from multiple threads */
 	void polys(const RectC &rect, int bits, QList<Poly> *polygons,
 	  QList<Poly> *lines);
 	void points(const RectC &rect, int bits, QList<Point> *points);
@@ -96,7 +97,7 @@ private:
 	{
 		PolyCTX(const RectC &rect, int bits, bool baseMap,
 		  QList<MapData::Poly> *polygons, QList<MapData::Poly> *lines,
-		  QCache<const SubDiv*, MapData::Polys> *polyCache)
+		  SubDivCache<MapData::Polys> *polyCache)
 		  : rect(rect), bits(bits), baseMap(baseMap), polygons(polygons),
 		  lines(lines), polyCache(polyCache) {}
 
@@ -105,14 +106,14 @@ private:
 		bool baseMap;
 		QList<MapData::Poly> *polygons;
 		QList<MapData::Poly> *lines;
-		QCache<const SubDiv*, MapData::Polys> *polyCache;
+		SubDivCache<MapData::Polys> *polyCache;
 	};
 
 	struct PointCTX
 	{
 		PointCTX(const RectC &rect, int bits, bool baseMap,
 		  QList<MapData::Point> *points,
-		  QCache<const SubDiv*, QList<MapData::Point> > *pointCache)
+		  SubDivCache<QList<MapData::Point> > *pointCache)
 		  : rect(rect), bits(bits), baseMap(baseMap), points(points),
 		  pointCache(pointCache) {}
 
@@ -120,14 +121,14 @@ private:
 		int bits;
 		bool baseMap;
 		QList<MapData::Point> *points;
-		QCache<const SubDiv*, QList<MapData::Point> > *pointCache;
+		SubDivCache<QList<MapData::Point> > *pointCache;
 	};
 
 	static bool polyCb(VectorTile *tile, void *context);
 	static bool pointCb(VectorTile *tile, void *context);
 
-	QCache<const SubDiv*, Polys> _polyCache;
-	QCache<const SubDiv*, QList<Point> > _pointCache;
+	SubDivCache<Polys> _polyCache;
+	SubDivCache<QList<Point> > _pointCache;
 
 	friend class VectorTile;
 	friend struct PolyCTX;
@@ -1,9 +1,9 @@
 #include <QFont>
 #include <QPainter>
 #include <QCache>
-#include "map/imgmap.h"
 #include "map/textpathitem.h"
 #include "map/textpointitem.h"
+#include "map/rendercache.h"
 #include "bitmapline.h"
 #include "style.h"
 #include "lblfile.h"
@@ -144,6 +144,13 @@ void RasterTile::render()
 {
 	QList<TextItem*> textItems;
 
+	if (RenderCache::load(_cacheFile, 1.0, _pixmap))
+		return;
+
+	_style = _data->style();
+	_data->polys(_polyRect, _zoom, &_polygons, &_lines);
+	_data->points(_pointRect, _zoom, &_points);
+
 	ll2xy(_polygons);
 	ll2xy(_lines);
 	ll2xy(_points);
@@ -152,20 +159,24 @@ void RasterTile::render()
 	processPolygons(textItems);
 	processLines(textItems);
 
+	_pixmap = QPixmap(_rect.size());
 	_pixmap.fill(Qt::transparent);
 
 	QPainter painter(&_pixmap);
 	painter.setRenderHint(QPainter::SmoothPixmapTransform);
 	painter.setRenderHint(QPainter::Antialiasing);
-	painter.translate(-_xy.x(), -_xy.y());
+	painter.translate(-_rect.x(), -_rect.y());
 
 	drawPolygons(&painter);
 	drawLines(&painter);
 	drawTextItems(&painter, textItems);
 	//painter.setPen(Qt::red);
-	//painter.drawRect(QRect(_xy, _img.size()));
+	//painter.drawRect(_rect);
 
 	qDeleteAll(textItems);
+
+	painter.end();
+	RenderCache::save(_cacheFile, _pixmap);
 }
 
 void RasterTile::ll2xy(QList<MapData::Poly> &polys)
@@ -174,7 +185,7 @@ void RasterTile::ll2xy(QList<MapData::Poly> &polys)
 		MapData::Poly &poly = polys[i];
 		for (int j = 0; j < poly.points.size(); j++) {
 			QPointF &p = poly.points[j];
-			p = _map->ll2xy(Coordinates(p.x(), p.y()));
+			p = ll2xy(Coordinates(p.x(), p.y()));
 		}
 	}
 }
@@ -182,7 +193,7 @@ void RasterTile::ll2xy(QList<MapData::Poly> &polys)
 void RasterTile::ll2xy(QList<MapData::Point> &points)
 {
 	for (int i = 0; i < points.size(); i++) {
-		QPointF p(_map->ll2xy(points.at(i).coordinates));
+		QPointF p(ll2xy(points.at(i).coordinates));
 		points[i].coordinates = Coordinates(p.x(), p.y());
 	}
 }
@@ -199,8 +210,8 @@ void RasterTile::drawPolygons(QPainter *painter)
 
 			if (poly.raster.isValid()) {
 				RectC r(poly.raster.rect());
-				QPointF tl(_map->ll2xy(r.topLeft()));
-				QPointF br(_map->ll2xy(r.bottomRight()));
+				QPointF tl(ll2xy(r.topLeft()));
+				QPointF br(ll2xy(r.bottomRight()));
 				QSizeF size(QRectF(tl, br).size());
 
 				bool insert = false;
@@ -284,7 +295,7 @@ static void removeDuplicitLabel(QList<TextItem *> &labels, const QString &text,
 
 void RasterTile::processPolygons(QList<TextItem*> &textItems)
 {
-	QRectF tileRect(_xy, _pixmap.size());
+	QRectF tileRect(_rect);
 	QSet<QString> set;
 	QList<TextItem *> labels;
 
@@ -321,7 +332,7 @@ void RasterTile::processPolygons(QList<TextItem*> &textItems)
 
 void RasterTile::processLines(QList<TextItem*> &textItems)
 {
-	QRect tileRect(_xy, _pixmap.size());
+	QRect tileRect(_rect);
 
 	std::stable_sort(_lines.begin(), _lines.end());
 
@@ -384,7 +395,7 @@ void RasterTile::processShields(const QRect &tileRect,
 		  it != shields.constEnd(); ++it) {
 			const QPolygonF &p = it.value();
 			QRectF rect(p.boundingRect() & tileRect);
-			if (AREA(rect) < AREA(QRect(0, 0, _pixmap.width()/4, _pixmap.width()/4)))
+			if (AREA(rect) < AREA(QRect(0, 0, _rect.width()/4, _rect.width()/4)))
 				continue;
 
 			QMap<qreal, int> map;
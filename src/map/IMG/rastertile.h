@@ -2,10 +2,12 @@
 #define IMG_RASTERTILE_H
 
 #include <QPixmap>
+#include "map/projection.h"
+#include "map/transform.h"
+#include "map/tilecache.h"
 #include "mapdata.h"
 
 class QPainter;
-class IMGMap;
 class TextItem;
 
 namespace IMG {
@@ -15,20 +17,28 @@ class Style;
 class RasterTile
 {
 public:
-	RasterTile(IMGMap *map, const Style *style, int zoom, const QRect &rect,
-	  const QString &key, const QList<MapData::Poly> &polygons,
-	  const QList<MapData::Poly> &lines, QList<MapData::Point> &points)
-	  : _map(map), _style(style), _zoom(zoom), _xy(rect.topLeft()),
-	  _key(key), _pixmap(rect.size()), _polygons(polygons), _lines(lines),
-	  _points(points) {}
-
-	const QString &key() const {return _key;}
-	const QPoint &xy() const {return _xy;}
+	RasterTile() : _data(0), _style(0), _zoom(0) {}
+	RasterTile(const Projection &proj, const Transform &transform,
+	  MapData *data, int zoom, const QRect &rect, const TileCache::Key &key,
+	  const RectC &polyRect, const RectC &pointRect)
+	  : _proj(proj), _transform(transform), _data(data), _style(0),
+	  _zoom(zoom), _rect(rect), _key(key), _polyRect(polyRect),
+	  _pointRect(pointRect) {}
+
+	const TileCache::Key &key() const {return _key;}
+	int zoom() const {return _zoom;}
+	const QRect &rect() const {return _rect;}
+	QPoint xy() const {return _rect.topLeft();}
+	/* The pixmap is null until the tile has been rendered */
 	const QPixmap &pixmap() const {return _pixmap;}
 
+	void setCacheFile(const QString &file) {_cacheFile = file;}
+
 	void render();
 
 private:
+	QPointF ll2xy(const Coordinates &c) const
+	  {return _transform.proj2img(_proj.ll2xy(c));}
 	void ll2xy(QList<MapData::Poly> &polys);
 	void ll2xy(QList<MapData::Point> &points);
 
@@ -42,11 +52,15 @@ private:
 	void processShields(const QRect &tileRect, QList<TextItem*> &textItems);
 	void processStreetNames(const QRect &tileRect, QList<TextItem*> &textItems);
 
-	IMGMap *_map;
+	Projection _proj;
+	Transform _transform;
+	MapData *_data;
 	const Style *_style;
 	int _zoom;
-	QPoint _xy;
-	QString _key;
+	QRect _rect;
+	TileCache::Key _key;
+	QString _cacheFile;
+	RectC _polyRect, _pointRect;
 	QPixmap _pixmap;
 	QList<MapData::Poly> _polygons;
 	QList<MapData::Poly> _lines;
@@ -0,0 +1,54 @@
+#ifndef IMG_SUBDIVCACHE_H
+#define IMG_SUBDIVCACHE_H
+
+#include <QCache>
+#include <QMutex>
+
+#define SUBDIV_CACHE_SHARDS 16
+
+namespace IMG {
+
+class SubDiv;
+
+/* Lock-striped subdiv cache. The shard lock of a subdiv (see lock()) must be
+   held while calling object()/insert() and while using the returned object,
+   as it may be evicted by another thread any time after the lock is released.
+*/
+template <class T>
+class SubDivCache
+{
+public:
+	SubDivCache(int maxCost)
+	{
+		for (int i = 0; i < SUBDIV_CACHE_SHARDS; i++)
+			_shards[i].cache.setMaxCost(qMax(maxCost / SUBDIV_CACHE_SHARDS, 1));
+	}
+
+	QMutex *lock(const SubDiv *subdiv) {return &shard(subdiv).lock;}
+	T *object(const SubDiv *subdiv) {return shard(subdiv).cache.object(subdiv);}
+	void insert(const SubDiv *subdiv, T *object)
+	  {shard(subdiv).cache.insert(subdiv, object);}
+
+	void clear()
+	{
+		for (int i = 0; i < SUBDIV_CACHE_SHARDS; i++) {
+			QMutexLocker locker(&_shards[i].lock);
+			_shards[i].cache.clear();
+		}
+	}
+
+private:
+	struct Shard {
+		QMutex lock;
+		QCache<const SubDiv*, T> cache;
+	};
+
+	Shard &shard(const SubDiv *subdiv)
+	  {return _shards[qHash(subdiv) % SUBDIV_CACHE_SHARDS];}
+
+	Shard _shards[SUBDIV_CACHE_SHARDS];
+};
+
+}
+
+#endif // IMG_SUBDIVCACHE_H
@@ -15,8 +15,13 @@ bool SubFile::seek(Handle &handle, quint32 pos) const
 		if (handle._blockNum != blockNum) {
 			if (blockNum >= _blocks->size())
 				return false;
-			if (!_img->readBlock(handle._file, _blocks->at(blockNum),
-			  handle._data.data()))
+			if (_img->isMapped()) {
+				const char *data = _img->block(_blocks->at(blockNum));
+				if (!data)
+					return false;
+				handle._data = data;
+			} else if (!_img->readBlock(handle._file, _blocks->at(blockNum),
+			  handle._buffer.data()))
 				return false;
 			handle._blockNum = blockNum;
 		}
@@ -29,7 +34,7 @@ bool SubFile::seek(Handle &handle, quint32 pos) const
 		if (handle._blockNum != blockNum) {
 			if (!handle._file.seek((quint64)blockNum << BLOCK_BITS))
 				return false;
-			if (handle._file.read(handle._data.data(), (1<<BLOCK_BITS)) < 0)
+			if (handle._file.read(handle._buffer.data(), (1<<BLOCK_BITS)) < 0)
 				return false;
 			handle._blockNum = blockNum;
 		}
@@ -120,15 +125,14 @@ bool SubFile::readVBitfield32(Handle &hdl, quint32 &bitfield) const
 bool SubFile::read(Handle &handle, char *buff, quint32 size) const
 {
 	while (size) {
-		quint32 remaining = handle._data.size() - handle._blockPos;
+		quint32 remaining = handle._blockSize - handle._blockPos;
 		if (size < remaining) {
-			memcpy(buff, handle._data.constData() + handle._blockPos, size);
+			memcpy(buff, handle._data + handle._blockPos, size);
 			handle._blockPos += size;
 			handle._pos += size;
 			return true;
 		} else {
-			memcpy(buff, handle._data.constData() + handle._blockPos,
-			  remaining);
+			memcpy(buff, handle._data + handle._blockPos, remaining);
 			buff += remaining;
 			size -= remaining;
 			handle._blockPos = 0;
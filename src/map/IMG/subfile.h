@@ -19,12 +19,19 @@ public:
 	{
 	public:
 		Handle(const SubFile *subFile)
-		  : _blockNum(-1), _blockPos(-1), _pos(-1)
+		  : _data(0), _blockSize(0), _blockNum(-1), _blockPos(-1), _pos(-1)
 		{
 			if (!subFile)
 				return;
 
-			_data.resize(1U<<subFile->blockBits());
+			_blockSize = 1U<<subFile->blockBits();
+			/* Memory-mapped files are accessed directly, no file handle or
+			   block buffer is needed */
+			if (subFile->isMapped())
+				return;
+
+			_buffer.resize(_blockSize);
+			_data = _buffer.constData();
 			_file.setFileName(subFile->fileName());
 			_file.open(QIODevice::ReadOnly);
 		}
@@ -33,7 +40,9 @@ public:
 		friend class SubFile;
 
 		QFile _file;
-		QByteArray _data;
+		QByteArray _buffer;
+		const char *_data;
+		int _blockSize;
 		int _blockNum;
 		int _blockPos;
 		int _pos;
@@ -60,9 +69,9 @@ public:
 
 	bool readByte(Handle &handle, quint8 *val) const
 	{
-		*val = handle._data.at(handle._blockPos++);
+		*val = handle._data[handle._blockPos++];
 		handle._pos++;
-		return (handle._blockPos >= handle._data.size())
+		return (handle._blockPos >= handle._blockSize)
 		  ? seek(handle, handle._pos) : true;
 	}
 
@@ -145,6 +154,7 @@ public:
 
 	const QString &fileName() const {return _path ? *_path : _img->fileName();}
 	unsigned blockBits() const {return _path ? BLOCK_BITS : _img->blockBits();}
+	bool isMapped() const {return _img && _img->isMapped();}
 
 protected:
 	quint32 _gmpOffset;
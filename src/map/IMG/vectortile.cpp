@@ -100,15 +100,24 @@ void VectorTile::clear()
 	_loaded = 0;
 }
 
+bool VectorTile::initSubdiv(SubFile::Handle &rgnHdl, SubDiv *subdiv)
+{
+	QMutexLocker locker(&_lock);
+	return (subdiv->initialized() || _rgn->subdivInit(rgnHdl, subdiv));
+}
+
 void VectorTile::polys(const RectC &rect, int bits, bool baseMap,
   QList<MapData::Poly> *polygons, QList<MapData::Poly> *lines,
-  QCache<const SubDiv *, MapData::Polys> *polyCache)
+  SubDivCache<MapData::Polys> *polyCache)
 {
 	SubFile::Handle *rgnHdl = 0, *lblHdl = 0, *netHdl = 0, *nodHdl = 0,
 	  *nodHdl2 = 0;
 
-	if (_loaded < 0)
+	_lock.lock();
+	if (_loaded < 0) {
+		_lock.unlock();
 		return;
+	}
 	if (!_loaded) {
 		rgnHdl = new SubFile::Handle(_rgn);
 		lblHdl = new SubFile::Handle(_lbl);
@@ -116,17 +125,22 @@ void VectorTile::polys(const RectC &rect, int bits, bool baseMap,
 		nodHdl = new SubFile::Handle(_nod);
 
 		if (!load(*rgnHdl, *lblHdl, *netHdl, *nodHdl)) {
+			_lock.unlock();
 			delete rgnHdl; delete lblHdl; delete netHdl; delete nodHdl;
 			return;
 		}
 	}
-
 	QList<SubDiv*> subdivs = _tre->subdivs(rect, bits, baseMap);
+	_lock.unlock();
+
 	for (int i = 0; i < subdivs.size(); i++) {
 		SubDiv *subdiv = subdivs.at(i);
 
+		QMutexLocker locker(polyCache->lock(subdiv));
 		MapData::Polys *polys = polyCache->object(subdiv);
 		if (!polys) {
+			locker.unlock();
+
 			quint32 shift = _tre->shift(subdiv->bits());
 			QList<MapData::Poly> p, l;
 
@@ -136,7 +150,7 @@ void VectorTile::polys(const RectC &rect, int bits, bool baseMap,
 				netHdl = new SubFile::Handle(_net);
 			}
 
-			if (!subdiv->initialized() && !_rgn->subdivInit(*rgnHdl, subdiv))
+			if (!initSubdiv(*rgnHdl, subdiv))
 				continue;
 
 			_rgn->polyObjects(*rgnHdl, subdiv, RGNFile::Polygon, _lbl, *lblHdl,
@@ -159,6 +173,8 @@ void VectorTile::polys(const RectC &rect, int bits, bool baseMap,
 
 			copyPolys(rect, &p, polygons);
 			copyPolys(rect, &l, lines);
+
+			locker.relock();
 			polyCache->insert(subdiv, new MapData::Polys(p, l));
 		} else {
 			copyPolys(rect, &(polys->polygons), polygons);
@@ -170,13 +186,16 @@ void VectorTile::polys(const RectC &rect, int bits, bool baseMap,
 }
 
 void VectorTile::points(const RectC &rect, int bits, bool baseMap,
-  QList<MapData::Point> *points, QCache<const SubDiv *,
-  QList<MapData::Point> > *pointCache)
+  QList<MapData::Point> *points,
+  SubDivCache<QList<MapData::Point> > *pointCache)
 {
 	SubFile::Handle *rgnHdl = 0, *lblHdl = 0;
 
-	if (_loaded < 0)
+	_lock.lock();
+	if (_loaded < 0) {
+		_lock.unlock();
 		return;
+	}
 	if (!_loaded) {
 		rgnHdl = new SubFile::Handle(_rgn);
 		lblHdl = new SubFile::Handle(_lbl);
@@ -184,17 +203,22 @@ void VectorTile::points(const RectC &rect, int bits, bool baseMap,
 		SubFile::Handle netHdl(_net);
 
 		if (!load(*rgnHdl, *lblHdl, netHdl, nodHdl)) {
+			_lock.unlock();
 			delete rgnHdl; delete lblHdl;
 			return;
 		}
 	}
-
 	QList<SubDiv*> subdivs = _tre->subdivs(rect, bits, baseMap);
+	_lock.unlock();
+
 	for (int i = 0; i < subdivs.size(); i++) {
 		SubDiv *subdiv = subdivs.at(i);
 
+		QMutexLocker locker(pointCache->lock(subdiv));
 		QList<MapData::Point> *pl = pointCache->object(subdiv);
 		if (!pl) {
+			locker.unlock();
+
 			QList<MapData::Point> p;
 
 			if (!rgnHdl) {
@@ -202,7 +226,7 @@ void VectorTile::points(const RectC &rect, int bits, bool baseMap,
 				lblHdl = new SubFile::Handle(_lbl);
 			}
 
-			if (!subdiv->initialized() && !_rgn->subdivInit(*rgnHdl, subdiv))
+			if (!initSubdiv(*rgnHdl, subdiv))
 				continue;
 
 			_rgn->pointObjects(*rgnHdl, subdiv, RGNFile::Point, _lbl, *lblHdl,
@@ -212,6 +236,8 @@ void VectorTile::points(const RectC &rect, int bits, bool baseMap,
 			_rgn->extPointObjects(*rgnHdl, subdiv, _lbl, *lblHdl, &p);
 
 			copyPoints(rect, &p, points);
+
+			locker.relock();
 			pointCache->insert(subdiv, new QList<MapData::Point>(p));
 		} else
 			copyPoints(rect, pl, points);
@@ -1,6 +1,7 @@
 #ifndef IMG_VECTORTILE_H
 #define IMG_VECTORTILE_H
 
+#include <QMutex>
 #include "trefile.h"
 #include "rgnfile.h"
 #include "lblfile.h"
@@ -30,10 +31,10 @@ public:
 
 	void polys(const RectC &rect, int bits, bool baseMap,
 	  QList<MapData::Poly> *polygons, QList<MapData::Poly> *lines,
-	  QCache<const SubDiv *, MapData::Polys> *polyCache);
+	  SubDivCache<MapData::Polys> *polyCache);
 	void points(const RectC &rect, int bits, bool baseMap,
-	  QList<MapData::Point> *points, QCache<const SubDiv*,
-	  QList<MapData::Point> > *pointCache);
+	  QList<MapData::Point> *points,
+	  SubDivCache<QList<MapData::Point> > *pointCache);
 
 	static bool isTileFile(SubFile::Type type)
 	{
@@ -73,6 +74,7 @@ private:
 	bool initGMP();
 	bool load(SubFile::Handle &rgnHdl, SubFile::Handle &lblHdl,
 	  SubFile::Handle &netHdl, SubFile::Handle &nodHdl);
+	bool initSubdiv(SubFile::Handle &rgnHdl, SubDiv *subdiv);
 
 	TREFile *_tre;
 	RGNFile *_rgn;
@@ -82,6 +84,8 @@ private:
 	SubFile *_gmp;
 
 	int _loaded;
+	/* Guards the lazy loading of the tile and its subdivs */
+	QMutex _lock;
 };
 
 }
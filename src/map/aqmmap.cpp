@@ -1,6 +1,5 @@
 #include <cctype>
 #include <QPainter>
-#include <QPixmapCache>
 #include <QImageReader>
 #include <QBuffer>
 #include <QtConcurrent>
@@ -13,11 +12,11 @@
 class AQTile
 {
 public:
-	AQTile(const QPoint &xy, const QByteArray &data, const QString &key)
+	AQTile(const QPoint &xy, const QByteArray &data, const TileCache::Key &key)
 	  : _xy(xy), _data(data), _key(key) {}
 
 	const QPoint &xy() const {return _xy;}
-	const QString &key() const {return _key;}
+	const TileCache::Key &key() const {return _key;}
 	const QPixmap &pixmap() const {return _pixmap;}
 
 	void load() {_pixmap.loadFromData(_data);}
@@ -25,7 +24,7 @@ public:
 private:
 	QPoint _xy;
 	QByteArray _data;
-	QString _key;
+	TileCache::Key _key;
 	QPixmap _pixmap;
 };
 
@@ -245,7 +244,7 @@ bool AQMMap::readHeader()
 
 AQMMap::AQMMap(const QString &fileName, QObject *parent)
   : Map(fileName, parent), _file(fileName), _zoom(0), _mapRatio(1.0),
-  _valid(false)
+  _cache(fileName), _valid(false)
 {
 	char magic[sizeof(MAGIC) - 1];
 
@@ -386,10 +385,9 @@ void AQMMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(z.zoom) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			TileCache::Key key(z.zoom, t.x(), t.y());
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (_cache.find(key, &pm)) {
 				QPointF tp(qMax(tl.x(), b.left()) + (t.x() - tile.x())
 				  * tileSize(), qMax(tl.y(), b.top()) + (t.y() - tile.y())
 				  * tileSize());
@@ -409,7 +407,7 @@ void AQMMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		if (pm.isNull())
 			continue;
 
-		QPixmapCache::insert(mt.key(), pm);
+		_cache.insert(mt.key(), pm);
 
 		QPointF tp(qMax(tl.x(), b.left()) + (mt.xy().x() - tile.x())
 		  * tileSize(), qMax(tl.y(), b.top()) + (mt.xy().y() - tile.y())
@@ -5,6 +5,7 @@
 #include <QFile>
 #include <QHash>
 #include "common/config.h"
+#include "tilecache.h"
 #include "map.h"
 
 class AQMMap : public Map
@@ -73,6 +74,7 @@ private:
 	int _zoom;
 	RectC _bounds;
 	qreal _mapRatio;
+	TileCache::Partition _cache;
 
 	bool _valid;
 	QString _errorString;
@@ -125,9 +125,10 @@ Atlas::Atlas(const QString &fileName, QObject *parent)
 			else
 				map = new OziMap(mapFile, this);
 
-			if (map->isValid())
+			if (map->isValid()) {
+				connect(map, &Map::tilesLoaded, this, &Map::tilesLoaded);
 				_maps.append(map);
-			else {
+			} else {
 				_errorString = QString("Error loading map: %1: %2")
 				  .arg(mapFile, map->errorString());
 				return;
@@ -1,7 +1,9 @@
 #include <cctype>
+#include <cstring>
 #include <QFileInfo>
 #include <QPainter>
-#include "image.h"
+#include <QtEndian>
+#include <QtMath>
 #include "gcs.h"
 #include "pcs.h"
 #include "calibrationpoint.h"
@@ -10,6 +12,11 @@
 
 
 #define LINE_LIMIT 1024
+#define TILE_SIZE  256
+#define BAND_SIZE  256
+#define MAX_LEVEL  4
+#define BAND_CACHE 32768 /* kB */
+#define MAX_BAND_CACHE 262144 /* kB */
 
 static inline bool isEOH(const QByteArray &line)
 {
@@ -276,6 +283,7 @@ bool BSBMap::createTransform(QList<ReferencePoint> &points)
 		QPolygonF a(QRectF(0, 0, _size.width(), _size.height()));
 		a = t.map(a);
 		_skewSize = a.boundingRect().toAlignedRect().size();
+		_skewMatrix = t;
 	}
 
 	_transform = Transform(points);
@@ -367,30 +375,193 @@ bool BSBMap::readRow(QFile &file, char bits, uchar *buf)
 	return true;
 }
 
-QImage BSBMap::readImage()
+/* The KAP files end with a table of the raster row offsets followed by the
+   offset of the table. If the table is missing or broken, the row offsets
+   are obtained by reading through the whole raster data (once). */
+bool BSBMap::readIndex()
 {
-	QFile file(path());
-	char bits;
+	quint32 offset;
+	qint64 tableSize = _size.height() * 4;
+
+	if (_rows.size() == _size.height())
+		return true;
+
+	if (_file.seek(_file.size() - 4)
+	  && _file.read((char*)&offset, sizeof(offset))
+	  == (qint64)sizeof(offset)) {
+		offset = qFromBigEndian(offset);
+		if (offset > _dataOffset && offset + tableSize <= _file.size() - 4
+		  && _file.seek(offset)) {
+			QByteArray table(_file.read(tableSize));
+			if (table.size() == tableSize) {
+				const uchar *data = (const uchar*)table.constData();
+				quint32 prev = _dataOffset;
+
+				_rows.resize(_size.height());
+				for (int i = 0; i < _size.height(); i++) {
+					_rows[i] = qFromBigEndian<quint32>(data + i * 4);
+					if (_rows.at(i) <= prev || _rows.at(i) >= offset) {
+						_rows.clear();
+						break;
+					}
+					prev = _rows.at(i);
+				}
+				if (!_rows.isEmpty())
+					return true;
+			}
+		}
+	}
 
-	if (!file.open(QIODevice::ReadOnly))
-		return QImage();
-	if (!(file.seek(_dataOffset) && file.getChar(&bits)))
-		return QImage();
+	QByteArray buf(_size.width(), 0);
+	if (!_file.seek(_dataOffset + 1))
+		return false;
+	_rows.resize(_size.height());
+	for (int i = 0; i < _size.height(); i++) {
+		_rows[i] = _file.pos();
+		if (!readRow(_file, _bits, (uchar*)buf.data())) {
+			_rows.clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+QImage *BSBMap::band(int band)
+{
+	QImage *img = _bands.object(band);
+	if (img)
+		return img;
+
+	int top = band * BAND_SIZE;
+	int height = qMin(BAND_SIZE, _size.height() - top);
+	if (height <= 0 || !_file.seek(_rows.at(top)))
+		return 0;
+
+	img = new QImage(_size.width(), height, QImage::Format_Indexed8);
+	for (int row = 0; row < height; row++) {
+		if (!readRow(_file, _bits, img->scanLine(row))) {
+			delete img;
+			return 0;
+		}
+	}
 
-	QImage img(_size, QImage::Format_Indexed8);
+	return _bands.insert(band, img, qMax(_size.width() * height / 1024, 1))
+	  ? img : 0;
+}
+
+QImage BSBMap::rows(const QRect &rect)
+{
+	QImage img(rect.size(), QImage::Format_Indexed8);
 	img.setColorTable(_palette);
 
-	for (int row = 0; row < _size.height(); row++) {
-		uchar *bsb_row = img.scanLine(row);
-		if (!readRow(file, bits, bsb_row))
+	for (int b = rect.top() / BAND_SIZE; b <= rect.bottom() / BAND_SIZE; b++) {
+		const QImage *bi = band(b);
+		if (!bi)
 			return QImage();
+
+		int top = qMax(rect.top(), b * BAND_SIZE);
+		int bottom = qMin(rect.bottom(), (b + 1) * BAND_SIZE - 1);
+		for (int row = top; row <= bottom; row++)
+			memcpy(img.scanLine(row - rect.top()), bi->constScanLine(row
+			  - b * BAND_SIZE) + rect.left(), rect.width());
+	}
+
+	return img;
+}
+
+/* Renders the level 0 tile from the raster rows it covers, skewed charts are
+   rotated per tile. The zoomed out levels are downscaled from the four tiles
+   of the next finer level, so the raster rows are decoded only for level 0
+   and no image larger than two tiles is ever created. */
+QImage BSBMap::tile(int level, int x, int y)
+{
+	int ts = TILE_SIZE << level;
+	QRect tr(QRect(x * ts, y * ts, ts, ts) & QRect(QPoint(0, 0), size()));
+
+	if (level) {
+		QImage img(((tr.width() - 1) >> (level - 1)) + 1,
+		  ((tr.height() - 1) >> (level - 1)) + 1,
+		  QImage::Format_ARGB32_Premultiplied);
+		img.fill(Qt::transparent);
+
+		QPainter painter(&img);
+		for (int j = 0; j < 2 && j * TILE_SIZE < img.height(); j++) {
+			for (int i = 0; i < 2 && i * TILE_SIZE < img.width(); i++) {
+				QPixmap pm(cachedTile(level - 1, 2 * x + i, 2 * y + j));
+				if (pm.isNull())
+					return QImage();
+				painter.drawPixmap(QRect(QPoint(i * TILE_SIZE, j * TILE_SIZE),
+				  pm.size()), pm, pm.rect());
+			}
+		}
+		painter.end();
+
+		return img.scaled(((tr.width() - 1) >> level) + 1,
+		  ((tr.height() - 1) >> level) + 1, Qt::IgnoreAspectRatio,
+		  Qt::SmoothTransformation);
 	}
 
+	if (!_skewSize.isValid())
+		return rows(tr);
+
+	QRect sr(_skewMatrix.inverted().mapRect(QRectF(tr)).toAlignedRect()
+	  & QRect(QPoint(0, 0), _size));
+	QImage img(tr.size(), QImage::Format_ARGB32_Premultiplied);
+	img.fill(Qt::transparent);
+	if (sr.isEmpty())
+		return img;
+
+	QImage src(rows(sr));
+	if (src.isNull())
+		return QImage();
+
+	QPainter painter(&img);
+	painter.setTransform(QTransform::fromTranslate(sr.left(), sr.top())
+	  * _skewMatrix * QTransform::fromTranslate(-tr.left(), -tr.top()));
+	painter.drawImage(QPoint(0, 0), src);
+
 	return img;
 }
 
+QPixmap BSBMap::cachedTile(int level, int x, int y)
+{
+	TileCache::Key key(level, x, y);
+	QPixmap pm;
+
+	if (!_cache.find(key, &pm)) {
+		pm = QPixmap::fromImage(tile(level, x, y));
+		if (pm.isNull())
+			return pm;
+		pm.setDevicePixelRatio(_ratio / (1 << level));
+		_cache.insert(key, pm);
+	}
+
+	return pm;
+}
+
+int BSBMap::level(const QPainter *painter) const
+{
+	const QTransform &t = painter->transform();
+	qreal scale = qSqrt(t.m11() * t.m11() + t.m12() * t.m12())
+	  * painter->device()->devicePixelRatioF();
+	if (scale <= 0)
+		return 0;
+
+	int l = 0;
+	for (qreal f = _ratio / scale; f >= 2.0 && l < MAX_LEVEL; f /= 2.0) {
+		if ((size().width() >> (l + 1)) < TILE_SIZE
+		  && (size().height() >> (l + 1)) < TILE_SIZE)
+			break;
+		l++;
+	}
+
+	return l;
+}
+
 BSBMap::BSBMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _img(0), _ratio(1.0), _dataOffset(-1), _valid(false)
+  : Map(fileName, parent), _ratio(1.0), _dataOffset(-1), _file(fileName),
+  _bits(0), _cache(fileName), _valid(false)
 {
 	QFile file(fileName);
 
@@ -404,12 +575,14 @@ BSBMap::BSBMap(const QString &fileName, QObject *parent)
 		return;
 	_dataOffset = file.pos();
 
-	_valid = true;
-}
+	/* Keep all the bands of a row of the coarsest level tiles, the tiles are
+	   built from the level 0 tiles they cover and the next tile in the row
+	   needs the same bands. */
+	int bands = (TILE_SIZE << MAX_LEVEL) / BAND_SIZE + 1;
+	_bands.setMaxCost(qBound(BAND_CACHE, bands * (_size.width() * BAND_SIZE
+	  / 1024), MAX_BAND_CACHE));
 
-BSBMap::~BSBMap()
-{
-	delete _img;
+	_valid = true;
 }
 
 QPointF BSBMap::ll2xy(const Coordinates &c)
@@ -431,33 +604,72 @@ QRectF BSBMap::bounds()
 
 void BSBMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	if (_img)
-		_img->draw(painter, rect, flags);
+	Q_UNUSED(flags);
+
+	if (!_file.isOpen())
+		return;
+
+	int l = level(painter);
+	qreal ratio = _ratio / (1 << l);
+	QRect ir(0, 0, ((size().width() - 1) >> l) + 1,
+	  ((size().height() - 1) >> l) + 1);
+	QRectF sr(QRectF(rect.topLeft() * ratio, rect.size() * ratio)
+	  .intersected(ir));
+	if (sr.isEmpty())
+		return;
+
+	/* Keep the pixmaps alive until the drawing is finished, see Image::draw()
+	   for the OpenGL QPainter issues. */
+	QList<QPixmap> list;
+	int left = qFloor(sr.left()) / TILE_SIZE;
+	int right = (qCeil(sr.right()) - 1) / TILE_SIZE;
+	int top = qFloor(sr.top()) / TILE_SIZE;
+	int bottom = (qCeil(sr.bottom()) - 1) / TILE_SIZE;
+
+	for (int j = top; j <= bottom; j++) {
+		for (int i = left; i <= right; i++) {
+			QPixmap pm(cachedTile(l, i, j));
+			if (pm.isNull()) {
+				qWarning("%s: error decoding tile (%d_%d_%d)",
+				  qPrintable(path()), l, i, j);
+				continue;
+			}
+
+			list.append(pm);
+			painter->drawPixmap(QPointF(i * TILE_SIZE, j * TILE_SIZE) / ratio,
+			  pm);
+		}
+	}
 }
 
 void BSBMap::setDevicePixelRatio(qreal deviceRatio, qreal mapRatio)
 {
 	Q_UNUSED(deviceRatio);
 
-	_ratio = mapRatio;
-	if (_img)
-		_img->setDevicePixelRatio(_ratio);
+	if (mapRatio != _ratio) {
+		_ratio = mapRatio;
+		_cache.clear();
+	}
 }
 
 void BSBMap::load()
 {
-	if (!_img) {
-		if (_skew > 0.0 && _skew < 360.0) {
-			QTransform matrix;
-			matrix.rotate(-_skew);
-			_img = new Image(readImage().transformed(matrix));
-		} else
-			_img = new Image(readImage());
+	if (_file.isOpen())
+		return;
+
+	if (!_file.open(QIODevice::ReadOnly)) {
+		qWarning("%s: %s", qPrintable(path()),
+		  qPrintable(_file.errorString()));
+		return;
+	}
+	if (!(_file.seek(_dataOffset) && _file.getChar(&_bits) && readIndex())) {
+		qWarning("%s: error reading BSB image data", qPrintable(path()));
+		_file.close();
 	}
 }
 
 void BSBMap::unload()
 {
-	delete _img;
-	_img = 0;
+	_bands.clear();
+	_file.close();
 }
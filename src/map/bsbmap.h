@@ -2,20 +2,20 @@
 #define BSBMAP_H
 
 #include <QColor>
+#include <QFile>
+#include <QCache>
+#include <QTransform>
 #include "transform.h"
 #include "projection.h"
+#include "tilecache.h"
 #include "map.h"
 
-class QFile;
-class Image;
-
 class BSBMap : public Map
 {
 	Q_OBJECT
 
 public:
 	BSBMap(const QString &fileName, QObject *parent = 0);
-	~BSBMap();
 
 	QString name() const {return _name;}
 
@@ -44,20 +44,32 @@ private:
 	bool createProjection(const QString &datum, const QString &proj,
 	  double params[9], const Coordinates &c);
 	bool createTransform(QList<ReferencePoint> &points);
-	QImage readImage();
 	bool readRow(QFile &file, char bits, uchar *buf);
+	bool readIndex();
+	QImage *band(int band);
+	QImage rows(const QRect &rect);
+	QImage tile(int level, int x, int y);
+	QPixmap cachedTile(int level, int x, int y);
+	int level(const QPainter *painter) const;
+	QSize size() const {return _skewSize.isValid() ? _skewSize : _size;}
 
 	QString _name;
 	Projection _projection;
 	Transform _transform;
 	qreal _skew;
-	Image *_img;
+	QTransform _skewMatrix;
 	QSize _size;
 	QSize _skewSize;
 	qreal _ratio;
 	qint64 _dataOffset;
 	QVector<QRgb> _palette;
 
+	QFile _file;
+	char _bits;
+	QVector<quint32> _rows;
+	QCache<int, QImage> _bands;
+	TileCache::Partition _cache;
+
 	bool _valid;
 	QString _errorString;
 };
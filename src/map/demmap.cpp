@@ -0,0 +1,285 @@
+#include <QtMath>
+#include <QPainter>
+#include "common/wgs84.h"
+#include "data/dem.h"
+#include "osm.h"
+#include "demmap.h"
+
+
+#define TILE_SIZE 256
+
+/* Light source direction (azimuth 315°, altitude 45°) as a unit vector with
+   the x axis pointing east and the y axis pointing north */
+#define LIGHT_X -0.5
+#define LIGHT_Y 0.5
+#define LIGHT_Z M_SQRT1_2
+
+struct ColorStop {
+	qreal elevation;
+	QRgb color;
+};
+
+static const ColorStop RELIEF[] = {
+	{0, qRgb(0x39, 0x80, 0x4d)},
+	{300, qRgb(0x7a, 0xaa, 0x5a)},
+	{700, qRgb(0xc4, 0xd0, 0x80)},
+	{1200, qRgb(0xe4, 0xd0, 0x8c)},
+	{1800, qRgb(0xc8, 0xa0, 0x64)},
+	{2500, qRgb(0xa0, 0x6e, 0x50)},
+	{3500, qRgb(0xc8, 0xbe, 0xb9)},
+	{5000, qRgb(0xff, 0xff, 0xff)}
+};
+
+static QRgb relief(qreal ele)
+{
+	const int last = sizeof(RELIEF) / sizeof(RELIEF[0]) - 1;
+
+	if (ele <= RELIEF[0].elevation)
+		return RELIEF[0].color;
+	if (ele >= RELIEF[last].elevation)
+		return RELIEF[last].color;
+
+	int i = 1;
+	while (RELIEF[i].elevation < ele)
+		i++;
+
+	const ColorStop &s0 = RELIEF[i-1];
+	const ColorStop &s1 = RELIEF[i];
+	qreal f = (ele - s0.elevation) / (s1.elevation - s0.elevation);
+
+	return qRgb(qRed(s0.color) + f * (qRed(s1.color) - qRed(s0.color)),
+	  qGreen(s0.color) + f * (qGreen(s1.color) - qGreen(s0.color)),
+	  qBlue(s0.color) + f * (qBlue(s1.color) - qBlue(s0.color)));
+}
+
+static inline qreal value(qreal ele, qreal center)
+{
+	return std::isnan(ele) ? center : ele;
+}
+
+/* Horn's method gradient of the 3x3 neighbourhood of the pixel p in the
+   elevations grid with the given row stride */
+static qreal shade(const qreal *p, int stride, qreal size)
+{
+	qreal e = p[0];
+	qreal a = value(p[-stride-1], e), b = value(p[-stride], e),
+	  c = value(p[-stride+1], e);
+	qreal d = value(p[-1], e), f = value(p[1], e);
+	qreal g = value(p[stride-1], e), h = value(p[stride], e),
+	  i = value(p[stride+1], e);
+
+	qreal dx = ((c + 2*f + i) - (a + 2*d + g)) / (8 * size);
+	qreal dy = ((a + 2*b + c) - (g + 2*h + i)) / (8 * size);
+	qreal s = (LIGHT_Z - dx * LIGHT_X - dy * LIGHT_Y) / qSqrt(1 + dx*dx + dy*dy);
+
+	return qMax(s, 0.0);
+}
+
+
+DEMMap::DEMMap(const QString &fileName, const QString &name, Style style,
+  const Range &zooms, const RectC &bounds, QObject *parent)
+  : Map(fileName, parent), _name(name), _style(style), _zooms(zooms),
+  _bounds(bounds), _zoom(_zooms.max()), _mapRatio(1.0), _tileRatio(1.0),
+  _cache(fileName), _loader(&_cache)
+{
+	connect(&_loader, &FileTileLoader::loaded, this, &Map::tilesLoaded);
+}
+
+DEMMap::~DEMMap()
+{
+	_loader.wait();
+}
+
+QRectF DEMMap::bounds()
+{
+	return QRectF(ll2xy(_bounds.topLeft()), ll2xy(_bounds.bottomRight()));
+}
+
+int DEMMap::limitZoom(int zoom) const
+{
+	if (zoom < _zooms.min())
+		return _zooms.min();
+	if (zoom > _zooms.max())
+		return _zooms.max();
+
+	return zoom;
+}
+
+int DEMMap::zoomFit(const QSize &size, const RectC &rect)
+{
+	if (!rect.isValid())
+		_zoom = _zooms.max();
+	else {
+		QRectF tbr(OSM::ll2m(rect.topLeft()), OSM::ll2m(rect.bottomRight()));
+		QPointF sc(tbr.width() / size.width(), tbr.height() / size.height());
+		_zoom = limitZoom(OSM::scale2zoom(qMax(sc.x(), -sc.y())
+		  / coordinatesRatio(), TILE_SIZE));
+	}
+
+	return _zoom;
+}
+
+qreal DEMMap::resolution(const QRectF &rect)
+{
+	return OSM::resolution(rect.center(), _zoom, TILE_SIZE);
+}
+
+int DEMMap::zoomIn()
+{
+	_zoom = qMin(_zoom + 1, _zooms.max());
+	return _zoom;
+}
+
+int DEMMap::zoomOut()
+{
+	_zoom = qMax(_zoom - 1, _zooms.min());
+	return _zoom;
+}
+
+void DEMMap::clearCache()
+{
+	_loader.wait();
+	_cache.clear();
+}
+
+void DEMMap::unload()
+{
+	_loader.wait();
+}
+
+void DEMMap::setDevicePixelRatio(qreal deviceRatio, qreal mapRatio)
+{
+	if (deviceRatio == _tileRatio && mapRatio == _mapRatio)
+		return;
+
+	/* The tiles are rendered in the device resolution, so all the cached
+	   tiles are invalid now. The running jobs read the ratio as well. */
+	_loader.wait();
+	_cache.clear();
+
+	_mapRatio = mapRatio;
+	_tileRatio = deviceRatio;
+}
+
+qreal DEMMap::coordinatesRatio() const
+{
+	return _mapRatio > 1.0 ? _mapRatio / _tileRatio : 1.0;
+}
+
+qreal DEMMap::imageRatio() const
+{
+	return _mapRatio > 1.0 ? _mapRatio : _tileRatio;
+}
+
+qreal DEMMap::tileSize() const
+{
+	return (TILE_SIZE / coordinatesRatio());
+}
+
+/* The tile elevations are sampled in the pixel centers on a grid with
+   a one pixel border, the border pixels are only used for the gradients.
+   All the grid points are fetched using a single batch DEM query. */
+QPixmap DEMMap::render(const FileTile &tile, QFile *file)
+{
+	Q_UNUSED(file);
+	const DEMMap *map = static_cast<const DEMMap*>(tile.context());
+	int size = qRound(TILE_SIZE * map->_tileRatio);
+	int stride = size + 2;
+	qreal tiles = 1<<tile.zoom();
+
+	QVector<Coordinates> c;
+	c.reserve(stride * stride);
+	for (int j = -1; j <= size; j++) {
+		qreal my = 180.0 - 360.0 * (tile.xy().y() + (j + 0.5) / size) / tiles;
+		qreal lat = OSM::m2ll(QPointF(0, my)).lat();
+		for (int i = -1; i <= size; i++) {
+			qreal lon = -180.0 + 360.0 * (tile.xy().x() + (i + 0.5) / size)
+			  / tiles;
+			c.append(Coordinates(lon, lat));
+		}
+	}
+	QVector<qreal> ele(DEM::elevation(c));
+
+	QImage img(size, size, QImage::Format_ARGB32_Premultiplied);
+	for (int j = 0; j < size; j++) {
+		QRgb *line = (QRgb*)img.scanLine(j);
+		const qreal *row = ele.constData() + (j + 1) * stride + 1;
+		/* Web Mercator pixels are square, the size only depends on latitude */
+		qreal ps = 2 * M_PI * WGS84_RADIUS
+		  * qCos(deg2rad(c.at((j + 1) * stride).lat())) / (tiles * size);
+
+		for (int i = 0; i < size; i++) {
+			const qreal *p = row + i;
+			if (std::isnan(*p)) {
+				line[i] = 0;
+				continue;
+			}
+
+			qreal s = shade(p, stride, ps);
+			if (map->_style == Relief) {
+				QRgb rgb = relief(*p);
+				qreal f = 0.4 + 0.6 * s / LIGHT_Z;
+				line[i] = qRgb(qMin(qRed(rgb) * f, 255.0),
+				  qMin(qGreen(rgb) * f, 255.0), qMin(qBlue(rgb) * f, 255.0));
+			} else {
+				int v = qRound(s * 255);
+				line[i] = qRgb(v, v, v);
+			}
+		}
+	}
+
+	return QPixmap::fromImage(img);
+}
+
+void DEMMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+{
+	qreal scale = OSM::zoom2scale(_zoom, TILE_SIZE);
+	QRectF b(bounds());
+	int max = 1<<_zoom;
+
+	QPoint tl(OSM::mercator2tile(QPointF(rect.left() * scale,
+	  -rect.top() * scale) * coordinatesRatio(), _zoom));
+	QPoint br(OSM::mercator2tile(QPointF(rect.right() * scale,
+	  -rect.bottom() * scale) * coordinatesRatio(), _zoom));
+	QList<FileTile> tiles;
+
+	for (int i = qMax(tl.x(), 0); i <= qMin(br.x(), max - 1); i++) {
+		for (int j = qMax(tl.y(), 0); j <= qMin(br.y(), max - 1); j++) {
+			QPoint t(i, j);
+			QPointF tp(OSM::tile2mercator(t, _zoom) / scale
+			  / coordinatesRatio());
+			if (!b.intersects(QRectF(tp, QSizeF(tileSize(), tileSize()))))
+				continue;
+
+			TileCache::Key key(_zoom, i, j);
+			QPixmap pixmap;
+
+			if (!(flags & Map::Block) && _loader.isRunning(key))
+				continue;
+
+			if (_cache.find(key, &pixmap))
+				painter->drawPixmap(tp, pixmap);
+			else {
+				FileTile tile(key, tp, imageRatio(), render, this);
+				tile.setXY(_zoom, t);
+				tiles.append(tile);
+			}
+		}
+	}
+
+	_loader.load(tiles, painter, flags);
+}
+
+QPointF DEMMap::ll2xy(const Coordinates &c)
+{
+	qreal scale = OSM::zoom2scale(_zoom, TILE_SIZE);
+	QPointF m = OSM::ll2m(c);
+	return QPointF(m.x() / scale, m.y() / -scale) / coordinatesRatio();
+}
+
+Coordinates DEMMap::xy2ll(const QPointF &p)
+{
+	qreal scale = OSM::zoom2scale(_zoom, TILE_SIZE);
+	return OSM::m2ll(QPointF(p.x() * scale, -p.y() * scale)
+	  * coordinatesRatio());
+}
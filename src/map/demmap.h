@@ -0,0 +1,66 @@
+#ifndef DEMMAP_H
+#define DEMMAP_H
+
+#include "common/range.h"
+#include "common/rectc.h"
+#include "tilecache.h"
+#include "filetile.h"
+#include "map.h"
+
+/* Terrain map rendered on the fly from the DEM data. The map uses the OSM
+   (Web Mercator) tile grid, the tiles are shaded in background threads and
+   stored in the tile cache. */
+class DEMMap : public Map
+{
+	Q_OBJECT
+
+public:
+	enum Style {
+		Hillshade,
+		Relief
+	};
+
+	DEMMap(const QString &fileName, const QString &name, Style style,
+	  const Range &zooms, const RectC &bounds, QObject *parent = 0);
+	~DEMMap();
+
+	QString name() const {return _name;}
+
+	QRectF bounds();
+	RectC llBounds() {return _bounds;}
+	qreal resolution(const QRectF &rect);
+
+	int zoom() const {return _zoom;}
+	void setZoom(int zoom) {_zoom = zoom;}
+	int zoomFit(const QSize &size, const RectC &rect);
+	int zoomIn();
+	int zoomOut();
+
+	QPointF ll2xy(const Coordinates &c);
+	Coordinates xy2ll(const QPointF &p);
+
+	void draw(QPainter *painter, const QRectF &rect, Flags flags);
+
+	void clearCache();
+	void unload();
+	void setDevicePixelRatio(qreal deviceRatio, qreal mapRatio);
+
+private:
+	int limitZoom(int zoom) const;
+	qreal tileSize() const;
+	qreal coordinatesRatio() const;
+	qreal imageRatio() const;
+
+	static QPixmap render(const FileTile &tile, QFile *file);
+
+	QString _name;
+	Style _style;
+	Range _zooms;
+	RectC _bounds;
+	int _zoom;
+	qreal _mapRatio, _tileRatio;
+	TileCache::Partition _cache;
+	FileTileLoader _loader;
+};
+
+#endif // DEMMAP_H
@@ -0,0 +1,113 @@
+#include <QPainter>
+#include "filetile.h"
+
+
+QFile *FilePool::acquire()
+{
+	QMutexLocker locker(&_lock);
+	if (!_files.isEmpty())
+		return _files.takeLast();
+	locker.unlock();
+
+	QFile *file = new QFile(_fileName);
+	if (!file->open(QIODevice::ReadOnly)) {
+		qWarning("%s: %s", qPrintable(_fileName),
+		  qPrintable(file->errorString()));
+		delete file;
+		return 0;
+	}
+
+	return file;
+}
+
+void FilePool::release(QFile *file)
+{
+	QMutexLocker locker(&_lock);
+	_files.append(file);
+}
+
+void FilePool::clear()
+{
+	QMutexLocker locker(&_lock);
+	qDeleteAll(_files);
+	_files.clear();
+}
+
+
+void FileTile::load()
+{
+	QFile *file = 0;
+
+	if (_pool && !(file = _pool->acquire()))
+		return;
+
+	_pixmap = _decoder(*this, file);
+	if (!_pixmap.isNull())
+		_pixmap.setDevicePixelRatio(_ratio);
+
+	if (_pool)
+		_pool->release(file);
+}
+
+
+bool FileTileLoader::insert(const FileTile &tile)
+{
+	if (tile.pixmap().isNull()) {
+		qWarning("%s: error loading tile image", qPrintable(_cache->name()));
+		return false;
+	}
+
+	_cache->insert(tile.key(), tile.pixmap());
+	return true;
+}
+
+void FileTileLoader::load(QList<FileTile> &tiles, QPainter *painter,
+  Map::Flags flags)
+{
+	if (tiles.isEmpty())
+		return;
+
+	if (flags & Map::Block) {
+		QFuture<void> future = QtConcurrent::map(tiles, &FileTile::load);
+		future.waitForFinished();
+
+		for (int i = 0; i < tiles.size(); i++) {
+			const FileTile &tile = tiles.at(i);
+			if (insert(tile))
+				painter->drawPixmap(tile.pos(), tile.pixmap());
+		}
+	} else {
+		FileTileJob *job = new FileTileJob(tiles);
+		connect(job, &FileTileJob::finished, this,
+		  &FileTileLoader::jobFinished);
+		_jobs.append(job);
+		for (int i = 0; i < tiles.size(); i++)
+			_running.insert(tiles.at(i).key());
+		job->run();
+	}
+}
+
+void FileTileLoader::wait()
+{
+	/* The tile decoders use the map data, so the jobs must not outlive it */
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->wait();
+}
+
+void FileTileLoader::jobFinished(FileTileJob *job)
+{
+	const QList<FileTile> &tiles = job->tiles();
+	bool changed = false;
+
+	for (int i = 0; i < tiles.size(); i++) {
+		if (insert(tiles.at(i)))
+			changed = true;
+		_running.remove(tiles.at(i).key());
+	}
+	_jobs.removeOne(job);
+
+	/* Only announce new tiles, failed tiles would be requested again on the
+	   repaint and end up in an endless load loop otherwise. */
+	if (changed)
+		emit loaded();
+}
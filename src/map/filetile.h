@@ -0,0 +1,147 @@
+#ifndef FILETILE_H
+#define FILETILE_H
+
+#include <QtConcurrent>
+#include <QFile>
+#include <QMutex>
+#include <QPixmap>
+#include <QSet>
+#include "tilecache.h"
+#include "map.h"
+
+class QPainter;
+
+/* Pool of read-only handles of a single file. Every thread reading the tiles
+   in parallel gets its own handle, the handles are reused by the subsequent
+   tile loads. */
+class FilePool
+{
+public:
+	FilePool(const QString &fileName) : _fileName(fileName) {}
+	~FilePool() {clear();}
+
+	QFile *acquire();
+	void release(QFile *file);
+	void clear();
+
+private:
+	Q_DISABLE_COPY(FilePool)
+
+	QString _fileName;
+	QMutex _lock;
+	QList<QFile*> _files;
+};
+
+/* Raster map tile stored in a map file. The tile is read and decoded by the
+   decoder function in a background thread. The context must outlive the
+   tile loading, the pool handle is only valid inside the decoder. */
+class FileTile
+{
+public:
+	typedef QPixmap (*Decoder)(const FileTile &tile, QFile *file);
+
+	FileTile() : _ratio(1.0), _decoder(0), _context(0), _pool(0), _zoom(0),
+	  _offset(0), _size(0) {}
+	FileTile(const TileCache::Key &key, const QPointF &pos, qreal ratio,
+	  Decoder decoder, const void *context, FilePool *pool = 0)
+	  : _key(key), _pos(pos), _ratio(ratio), _decoder(decoder),
+	  _context(context), _pool(pool), _zoom(0), _offset(0), _size(0) {}
+
+	void setXY(int zoom, const QPoint &xy) {_zoom = zoom; _xy = xy;}
+	void setOffset(quint64 offset, quint32 size)
+	  {_offset = offset; _size = size;}
+
+	const TileCache::Key &key() const {return _key;}
+	const QPointF &pos() const {return _pos;}
+	const void *context() const {return _context;}
+	int zoom() const {return _zoom;}
+	const QPoint &xy() const {return _xy;}
+	quint64 offset() const {return _offset;}
+	quint32 size() const {return _size;}
+
+	const QPixmap &pixmap() const {return _pixmap;}
+
+	void load();
+
+private:
+	TileCache::Key _key;
+	QPointF _pos;
+	qreal _ratio;
+	Decoder _decoder;
+	const void *_context;
+	FilePool *_pool;
+	int _zoom;
+	QPoint _xy;
+	quint64 _offset;
+	quint32 _size;
+	QPixmap _pixmap;
+};
+
+class FileTileJob : public QObject
+{
+	Q_OBJECT
+
+public:
+	FileTileJob(const QList<FileTile> &tiles) : _tiles(tiles)
+	{
+		connect(&_watcher, &QFutureWatcher<void>::finished, this,
+		  &FileTileJob::handleFinished);
+	}
+
+	void run()
+	{
+		_future = QtConcurrent::map(_tiles, &FileTile::load);
+		_watcher.setFuture(_future);
+	}
+	void wait() {_future.waitForFinished();}
+
+	const QList<FileTile> &tiles() const {return _tiles;}
+
+signals:
+	void finished(FileTileJob *job);
+
+private slots:
+	void handleFinished()
+	{
+		emit finished(this);
+
+		deleteLater();
+	}
+
+private:
+	QFutureWatcher<void> _watcher;
+	QFuture<void> _future;
+	QList<FileTile> _tiles;
+};
+
+/* Loads the map file tiles into the map tile cache. In the Map::Block mode
+   the tiles are loaded synchronously and drawn, otherwise they are loaded
+   in the background and loaded() is emitted when new tiles are available. */
+class FileTileLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	FileTileLoader(TileCache::Partition *cache) : _cache(cache) {}
+	~FileTileLoader() {wait();}
+
+	bool isRunning(const TileCache::Key &key) const
+	  {return _running.contains(key);}
+	void load(QList<FileTile> &tiles, QPainter *painter, Map::Flags flags);
+	void wait();
+
+signals:
+	void loaded();
+
+private slots:
+	void jobFinished(FileTileJob *job);
+
+private:
+	bool insert(const FileTile &tile);
+
+	TileCache::Partition *_cache;
+	QSet<TileCache::Key> _running;
+	QList<FileTileJob*> _jobs;
+};
+
+#endif // FILETILE_H
@@ -1,20 +1,35 @@
 #include <QPainter>
 #include <QImageReader>
 #include "common/util.h"
+#include "common/rectc.h"
 #include "geotiff.h"
 #include "image.h"
+#include "tiffimage.h"
+#include "rectd.h"
 #include "geotiffmap.h"
 
 
 GeoTIFFMap::GeoTIFFMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _img(0), _ratio(1.0), _valid(false)
+  : Map(fileName, parent), _img(0), _tiff(0), _zoom(0), _scale(1.0, 1.0),
+  _ratio(1.0), _cache(fileName), _valid(false)
 {
-	QImageReader ir(fileName);
-	if (!ir.canRead()) {
-		_errorString = "Unsupported/invalid image file";
-		return;
+	/* Tiled/striped images are read by parts, the whole image is loaded only
+	   if the TIFF layout/compression is not supported by TIFFImage. */
+	_tiff = new TIFFImage(fileName);
+	if (_tiff->open()) {
+		_size = _tiff->size(0);
+		_tiff->close();
+	} else {
+		delete _tiff;
+		_tiff = 0;
+
+		QImageReader ir(fileName);
+		if (!ir.canRead()) {
+			_errorString = "Unsupported/invalid image file";
+			return;
+		}
+		_size = ir.size();
 	}
-	_size = ir.size();
 
 	GeoTIFF gt(fileName);
 	if (!gt.isValid()) {
@@ -31,26 +46,122 @@ GeoTIFFMap::GeoTIFFMap(const QString &fileName, QObject *parent)
 GeoTIFFMap::~GeoTIFFMap()
 {
 	delete _img;
+	delete _tiff;
 }
 
 QPointF GeoTIFFMap::ll2xy(const Coordinates &c)
 {
-	return QPointF(_transform.proj2img(_projection.ll2xy(c))) / _ratio;
+	QPointF p(_transform.proj2img(_projection.ll2xy(c)));
+	return QPointF(p.x() * _scale.x(), p.y() * _scale.y()) / _ratio;
 }
 
 Coordinates GeoTIFFMap::xy2ll(const QPointF &p)
 {
-	return _projection.xy2ll(_transform.img2proj(p * _ratio));
+	return _projection.xy2ll(_transform.img2proj(QPointF(p.x() / _scale.x(),
+	  p.y() / _scale.y()) * _ratio));
 }
 
 QRectF GeoTIFFMap::bounds()
 {
-	return QRectF(QPointF(0, 0), _size / _ratio);
+	return _tiff
+	  ? QRectF(QPointF(0, 0), _tiff->size(_zoom) / _ratio)
+	  : QRectF(QPointF(0, 0), _size / _ratio);
+}
+
+void GeoTIFFMap::setZoom(int zoom)
+{
+	if (_tiff)
+		rescale(zoom);
+}
+
+int GeoTIFFMap::zoomFit(const QSize &size, const RectC &rect)
+{
+	if (!_tiff)
+		return _zoom;
+
+	if (!rect.isValid())
+		rescale(0);
+	else {
+		RectD prect(rect, _projection);
+		QRectF sbr(_transform.proj2img(prect.topLeft()),
+		  _transform.proj2img(prect.bottomRight()));
+
+		for (int i = 0; i < _tiff->zooms(); i++) {
+			rescale(i);
+			if (sbr.size().width() * _scale.x() <= size.width()
+			  && sbr.size().height() * _scale.y() <= size.height())
+				break;
+		}
+	}
+
+	return _zoom;
+}
+
+int GeoTIFFMap::zoomIn()
+{
+	if (_tiff)
+		rescale(qMax(_zoom - 1, 0));
+
+	return _zoom;
+}
+
+int GeoTIFFMap::zoomOut()
+{
+	if (_tiff)
+		rescale(qMin(_zoom + 1, _tiff->zooms() - 1));
+
+	return _zoom;
+}
+
+void GeoTIFFMap::rescale(int zoom)
+{
+	_zoom = zoom;
+	_scale = _tiff->scale(zoom);
+}
+
+void GeoTIFFMap::drawTiled(QPainter *painter, const QRectF &rect)
+{
+	QRectF br(rect.intersected(bounds()));
+	if (br.isEmpty())
+		return;
+
+	QSize tileSize(_tiff->tileSize(_zoom));
+	QSizeF ts(tileSize.width() / _ratio, tileSize.height() / _ratio);
+	QPointF tl(floor(br.left() / ts.width()) * ts.width(),
+	  floor(br.top() / ts.height()) * ts.height());
+
+	QSizeF s(br.right() - tl.x(), br.bottom() - tl.y());
+	for (int j = 0; j < ceil(s.height() / ts.height()); j++) {
+		for (int i = 0; i < ceil(s.width() / ts.width()); i++) {
+			int x = round(tl.x() * _ratio + i * tileSize.width());
+			int y = round(tl.y() * _ratio + j * tileSize.height());
+
+			QPixmap pixmap;
+			TileCache::Key key(_zoom, x, y);
+			if (!_cache.find(key, &pixmap)) {
+				pixmap = QPixmap::fromImage(_tiff->tile(_zoom, x, y));
+				if (!pixmap.isNull())
+					_cache.insert(key, pixmap);
+			}
+
+			if (pixmap.isNull())
+				qWarning("%s: error loading tile image (%d_%d_%d)",
+				  qPrintable(_tiff->fileName()), _zoom, x, y);
+			else {
+				pixmap.setDevicePixelRatio(_ratio);
+				QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
+				painter->drawPixmap(tp, pixmap);
+			}
+		}
+	}
 }
 
 void GeoTIFFMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	if (_img)
+	if (_tiff) {
+		if (_tiff->isOpen())
+			drawTiled(painter, rect);
+	} else if (_img)
 		_img->draw(painter, rect, flags);
 }
 
@@ -65,12 +176,19 @@ void GeoTIFFMap::setDevicePixelRatio(qreal deviceRatio, qreal mapRatio)
 
 void GeoTIFFMap::load()
 {
-	if (!_img)
+	if (_tiff) {
+		if (!_tiff->isOpen() && !_tiff->open())
+			qWarning("%s: %s", qPrintable(path()),
+			  qPrintable(_tiff->errorString()));
+	} else if (!_img)
 		_img = new Image(path());
 }
 
 void GeoTIFFMap::unload()
 {
+	if (_tiff)
+		_tiff->close();
+
 	delete _img;
 	_img = 0;
 }
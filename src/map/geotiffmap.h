@@ -3,9 +3,11 @@
 
 #include "transform.h"
 #include "projection.h"
+#include "tilecache.h"
 #include "map.h"
 
 class Image;
+class TIFFImage;
 
 class GeoTIFFMap : public Map
 {
@@ -16,6 +18,13 @@ public:
 	~GeoTIFFMap();
 
 	QRectF bounds();
+
+	int zoom() const {return _zoom;}
+	void setZoom(int zoom);
+	int zoomFit(const QSize &size, const RectC &rect);
+	int zoomIn();
+	int zoomOut();
+
 	QPointF ll2xy(const Coordinates &c);
 	Coordinates xy2ll(const QPointF &p);
 
@@ -29,11 +38,18 @@ public:
 	QString errorString() const {return _errorString;}
 
 private:
+	void drawTiled(QPainter *painter, const QRectF &rect);
+	void rescale(int zoom);
+
 	Projection _projection;
 	Transform _transform;
 	Image *_img;
+	TIFFImage *_tiff;
 	QSize _size;
+	int _zoom;
+	QPointF _scale;
 	qreal _ratio;
+	TileCache::Partition _cache;
 
 	bool _valid;
 	QString _errorString;
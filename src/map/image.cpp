@@ -1,41 +1,93 @@
 #include <QPainter>
+#include <QtMath>
 #include "image.h"
 
 
 #define TILE_SIZE 256
 
+/* Returns the smallest pyramid level with a resolution not lower than the
+   output device resolution. Missing levels are created on the fly. */
+int Image::level(const QPainter *painter)
+{
+	const QTransform &t = painter->transform();
+	qreal scale = qSqrt(t.m11() * t.m11() + t.m12() * t.m12())
+	  * painter->device()->devicePixelRatioF();
+	if (scale <= 0)
+		return 0;
+
+	qreal f = _ratio / scale;
+	int l = 0;
+
+	while (f >= 2.0) {
+		const QImage &img = _levels.at(l);
+		if (img.width() < 2 * TILE_SIZE && img.height() < 2 * TILE_SIZE)
+			break;
+
+		if (l + 1 == _levels.size())
+			_levels.append(img.scaled(qMax(img.width() / 2, 1),
+			  qMax(img.height() / 2, 1), Qt::IgnoreAspectRatio,
+			  Qt::SmoothTransformation));
+		l++;
+		f /= 2.0;
+	}
+
+	return l;
+}
+
 void Image::draw(QPainter *painter, const QRectF &rect, Map::Flags flags)
 {
-	qreal ratio = _img.devicePixelRatioF();
-	QRectF sr(rect.topLeft() * ratio, rect.size() * ratio);
-
-	/* When OpenGL is used, big images are rendered incredibly slow or not at
-	   all using the QPainter::drawImage() function with a source rect set. So
-	   we have to tile the image ourself before it can be drawn.
-
-	   We have to use a list of dynamically allocated pixmaps as QPainter
-	   rendering is broken in yet another way with OpenGL and drawPixmap() does
-	   access already deleted image instances when reusing a single pixmap. */
-	if (flags & Map::OpenGL) {
-		QList<QPixmap *> list;
-
-		for (int i = sr.left()/TILE_SIZE; i <= sr.right()/TILE_SIZE; i++) {
-			for (int j = sr.top()/TILE_SIZE; j <= sr.bottom()/TILE_SIZE; j++) {
-				QPoint tl(i * TILE_SIZE, j * TILE_SIZE);
-				QRect tile(tl, QSize(TILE_SIZE, TILE_SIZE));
-				QPixmap *pm = new QPixmap(QPixmap::fromImage(_img.copy(tile)));
-				list.append(pm);
-				pm->setDevicePixelRatio(ratio);
-				painter->drawPixmap(tl/ratio, *pm);
+	Q_UNUSED(flags);
+
+	if (_levels.first().isNull())
+		return;
+
+	int l = level(painter);
+	const QImage &img = _levels.at(l);
+	qreal ratio = _ratio / (1 << l);
+	QRect ir(QPoint(0, 0), img.size());
+	QRectF sr(QRectF(rect.topLeft() * ratio, rect.size() * ratio)
+	  .intersected(ir));
+	if (sr.isEmpty())
+		return;
+
+	/* The image is always drawn using pixmap tiles. Drawing big images using
+	   QPainter::drawImage() with a source rect set is incredibly slow or does
+	   not work at all with OpenGL and drawing a downscaled image requires
+	   a full-image resample on every paint.
+
+	   The pixmaps must be kept alive until the drawing is finished as
+	   QPainter rendering is broken in yet another way with OpenGL and
+	   drawPixmap() does access already deleted image instances. */
+	QList<QPixmap> list;
+	int left = qFloor(sr.left()) / TILE_SIZE;
+	int right = (qCeil(sr.right()) - 1) / TILE_SIZE;
+	int top = qFloor(sr.top()) / TILE_SIZE;
+	int bottom = (qCeil(sr.bottom()) - 1) / TILE_SIZE;
+
+	for (int i = left; i <= right; i++) {
+		for (int j = top; j <= bottom; j++) {
+			QPoint tl(i * TILE_SIZE, j * TILE_SIZE);
+			TileCache::Key key(l, i, j);
+			QPixmap pm;
+
+			if (!_cache.find(key, &pm)) {
+				pm = QPixmap::fromImage(img.copy(QRect(tl, QSize(TILE_SIZE,
+				  TILE_SIZE)) & ir));
+				pm.setDevicePixelRatio(ratio);
+				_cache.insert(key, pm);
 			}
-		}
 
-		qDeleteAll(list);
-	} else
-		painter->drawImage(rect.topLeft(), _img, sr);
+			list.append(pm);
+			painter->drawPixmap(QPointF(tl) / ratio, pm);
+		}
+	}
 }
 
 void Image::setDevicePixelRatio(qreal ratio)
 {
-	_img.setDevicePixelRatio(ratio);
+	if (ratio == _ratio)
+		return;
+
+	_ratio = ratio;
+	_cache.clear();
 }
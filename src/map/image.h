@@ -2,21 +2,32 @@
 #define IMAGE_H
 
 #include <QImage>
+#include <QVector>
+#include "tilecache.h"
 #include "map.h"
 
 class QPainter;
 
+/* Single image map raster. The image is drawn from cached pixmap tiles of a
+   multi-resolution pyramid, the pyramid levels (each half the size of the
+   previous one) are created on demand when the image is drawn downscaled. */
 class Image
 {
 public:
-	Image(const QString &fileName) : _img(fileName) {}
-	Image(const QImage &img) : _img(img) {}
+	Image(const QString &fileName)
+	  : _ratio(1.0), _cache(fileName) {_levels.append(QImage(fileName));}
+	Image(const QImage &img, const QString &name)
+	  : _ratio(1.0), _cache(name) {_levels.append(img);}
 
 	void draw(QPainter *painter, const QRectF &rect, Map::Flags flags);
 	void setDevicePixelRatio(qreal ratio);
 
 private:
-	QImage _img;
+	int level(const QPainter *painter);
+
+	QVector<QImage> _levels;
+	qreal _ratio;
+	TileCache::Partition _cache;
 };
 
 #endif // IMAGE_H
@@ -1,13 +1,11 @@
 #include <QFile>
 #include <QPainter>
-#include <QPixmapCache>
-#include <QtConcurrent>
 #include "common/rectc.h"
 #include "common/range.h"
 #include "common/wgs84.h"
+#include "common/programpaths.h"
 #include "IMG/imgdata.h"
 #include "IMG/gmapdata.h"
-#include "IMG/rastertile.h"
 #include "osm.h"
 #include "pcs.h"
 #include "rectd.h"
@@ -41,7 +39,8 @@ static QList<MapData*> overlays(const QString &fileName)
 }
 
 IMGMap::IMGMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _projection(PCS::pcs(3857)), _valid(false)
+  : Map(fileName, parent), _projection(PCS::pcs(3857)), _valid(false),
+  _cache(fileName)
 {
 	if (GMAPData::isGMAP(fileName))
 		_data.append(new GMAPData(fileName));
@@ -55,6 +54,10 @@ IMGMap::IMGMap(const QString &fileName, QObject *parent)
 		return;
 	}
 
+	for (int i = 0; i < _data.size(); i++)
+		_renderCache.append(RenderCache(_data.at(i)->fileName(),
+		  ProgramPaths::typFile()));
+
 	_dataBounds = _data.first()->bounds() & OSM::BOUNDS;
 	_zoom = _data.first()->zooms().min();
 	updateTransform();
@@ -62,6 +65,12 @@ IMGMap::IMGMap(const QString &fileName, QObject *parent)
 	_valid = true;
 }
 
+IMGMap::~IMGMap()
+{
+	waitForJobs();
+	qDeleteAll(_data);
+}
+
 void IMGMap::load()
 {
 	for (int i = 0; i < _data.size(); i++)
@@ -70,6 +79,8 @@ void IMGMap::load()
 
 void IMGMap::unload()
 {
+	waitForJobs();
+
 	for (int i = 0; i < _data.size(); i++)
 		_data.at(i)->clear();
 }
@@ -138,10 +149,72 @@ void IMGMap::updateTransform()
 		_bounds.adjust(0.5, 0, -0.5, 0);
 }
 
-void IMGMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+bool IMGMap::isRunning(const TileCache::Key &key) const
+{
+	return _running.contains(key);
+}
+
+void IMGMap::addRunning(const QList<RasterTile> &tiles)
 {
-	Q_UNUSED(flags);
+	for (int i = 0; i < tiles.size(); i++)
+		_running.insert(tiles.at(i).key());
+}
 
+void IMGMap::removeRunning(const QList<RasterTile> &tiles)
+{
+	for (int i = 0; i < tiles.size(); i++)
+		_running.remove(tiles.at(i).key());
+}
+
+void IMGMap::cancelJobs(const QRectF &rect)
+{
+	/* Tiles of canceled jobs are removed from the running set once the jobs
+	   finish, so they get requested again if they become visible */
+	for (int i = 0; i < _jobs.size(); i++) {
+		IMGMapJob *job = _jobs.at(i);
+		if (job->zoom() != _zoom || !job->intersects(rect))
+			job->cancel();
+	}
+}
+
+void IMGMap::waitForJobs()
+{
+	for (int i = 0; i < _jobs.size(); i++) {
+		_jobs.at(i)->cancel();
+		_jobs.at(i)->wait();
+	}
+}
+
+/* The jobs are stopped and their results discarded, used when the rendered
+   tiles would not match the map setup anymore */
+void IMGMap::dropJobs()
+{
+	waitForJobs();
+
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->disconnect(this);
+	_jobs.clear();
+	_running.clear();
+}
+
+void IMGMap::jobFinished(IMGMapJob *job)
+{
+	const QList<RasterTile> &tiles = job->tiles();
+
+	/* Tiles of canceled jobs that were not rendered have null pixmaps */
+	for (int i = 0; i < tiles.size(); i++) {
+		const RasterTile &rt = tiles.at(i);
+		if (!rt.pixmap().isNull())
+			_cache.insert(rt.key(), rt.pixmap());
+	}
+
+	_jobs.removeOne(job);
+	removeRunning(job->tiles());
+	emit tilesLoaded();
+}
+
+void IMGMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
+{
 	QPointF tl(floor(rect.left() / TILE_SIZE)
 	  * TILE_SIZE, floor(rect.top() / TILE_SIZE) * TILE_SIZE);
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
@@ -150,26 +223,29 @@ void IMGMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 
 	QList<RasterTile> tiles;
 
+	if (!(flags & Map::Block))
+		cancelJobs(rect);
+
 	for (int n = 0; n < _data.size(); n++) {
+		QString cachePath(_renderCache.at(n).path(_zoom, _projection, 1.0));
+
 		for (int i = 0; i < width; i++) {
 			for (int j = 0; j < height; j++) {
 				QPixmap pm;
 				QPoint ttl(tl.x() + i * TILE_SIZE, tl.y() + j * TILE_SIZE);
-				QString key = _data.at(n)->fileName() + "-" + QString::number(_zoom)
-				  + "_" + QString::number(ttl.x()) + "_" + QString::number(ttl.y());
-				if (QPixmapCache::find(key, &pm))
+				TileCache::Key key(_zoom, ttl.x(), ttl.y(), n);
+
+				if (!(flags & Map::Block) && isRunning(key))
+					continue;
+
+				if (_cache.find(key, &pm))
 					painter->drawPixmap(ttl, pm);
 				else {
-					QList<MapData::Poly> polygons, lines;
-					QList<MapData::Point> points;
-
 					QRectF polyRect(ttl, QPointF(ttl.x() + TILE_SIZE,
 					  ttl.y() + TILE_SIZE));
 					polyRect &= _bounds;
 					RectD polyRectD(_transform.img2proj(polyRect.topLeft()),
 					  _transform.img2proj(polyRect.bottomRight()));
-					_data.at(n)->polys(polyRectD.toRectC(_projection, 20), _zoom,
-					  &polygons, &lines);
 
 					QRectF pointRect(QPointF(ttl.x() - TEXT_EXTENT,
 					  ttl.y() - TEXT_EXTENT), QPointF(ttl.x() + TILE_SIZE
@@ -177,28 +253,40 @@ void IMGMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 					pointRect &= _bounds;
 					RectD pointRectD(_transform.img2proj(pointRect.topLeft()),
 					  _transform.img2proj(pointRect.bottomRight()));
-					_data.at(n)->points(pointRectD.toRectC(_projection, 20),
-					  _zoom, &points);
 
-					tiles.append(RasterTile(this, _data.at(n)->style(), _zoom,
-					  QRect(ttl, QSize(TILE_SIZE, TILE_SIZE)), key, polygons,
-					  lines, points));
+					RasterTile rt(_projection, _transform, _data.at(n), _zoom,
+					  QRect(ttl, QSize(TILE_SIZE, TILE_SIZE)), key,
+					  polyRectD.toRectC(_projection, 20),
+					  pointRectD.toRectC(_projection, 20));
+					rt.setCacheFile(RenderCache::tileFile(cachePath, ttl));
+					tiles.append(rt);
 				}
 			}
 		}
 	}
 
-	QFuture<void> future = QtConcurrent::map(tiles, &RasterTile::render);
-	future.waitForFinished();
+	if (tiles.isEmpty())
+		return;
 
-	for (int i = 0; i < tiles.size(); i++) {
-		RasterTile &mt = tiles[i];
-		const QPixmap &pm = mt.pixmap();
-		if (pm.isNull())
-			continue;
+	if (flags & Map::Block) {
+		QFuture<void> future = QtConcurrent::map(tiles, &RasterTile::render);
+		future.waitForFinished();
+
+		for (int i = 0; i < tiles.size(); i++) {
+			RasterTile &mt = tiles[i];
+			const QPixmap &pm = mt.pixmap();
+			if (pm.isNull())
+				continue;
 
-		painter->drawPixmap(mt.xy(), pm);
-		QPixmapCache::insert(mt.key(), pm);
+			painter->drawPixmap(mt.xy(), pm);
+			_cache.insert(mt.key(), pm);
+		}
+	} else {
+		IMGMapJob *job = new IMGMapJob(tiles, _zoom);
+		connect(job, &IMGMapJob::finished, this, &IMGMap::jobFinished);
+		_jobs.append(job);
+		addRunning(tiles);
+		job->run();
 	}
 }
 
@@ -207,6 +295,8 @@ void IMGMap::setOutputProjection(const Projection &projection)
 	if (projection == _projection)
 		return;
 
+	dropJobs();
+
 	_projection = projection;
 	// Limit the bounds for some well known projections
 	// (world maps have N/S bounds up to 90/-90!)
@@ -222,5 +312,5 @@ void IMGMap::setOutputProjection(const Projection &projection)
 		_dataBounds = _data.first()->bounds();
 
 	updateTransform();
-	QPixmapCache::clear();
+	_cache.clear();
 }
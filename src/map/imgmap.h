@@ -1,11 +1,62 @@
 #ifndef IMGMAP_H
 #define IMGMAP_H
 
+#include <QtConcurrent>
 #include "map.h"
 #include "projection.h"
 #include "transform.h"
+#include "rendercache.h"
+#include "tilecache.h"
 #include "IMG/mapdata.h"
+#include "IMG/rastertile.h"
 
+class IMGMapJob : public QObject
+{
+	Q_OBJECT
+
+public:
+	IMGMapJob(const QList<IMG::RasterTile> &tiles, int zoom)
+	  : _tiles(tiles), _zoom(zoom)
+	{
+		connect(&_watcher, &QFutureWatcher<void>::finished, this,
+		  &IMGMapJob::handleFinished);
+	}
+
+	void run()
+	{
+		_future = QtConcurrent::map(_tiles, &IMG::RasterTile::render);
+		_watcher.setFuture(_future);
+	}
+	void cancel() {_future.cancel();}
+	void wait() {_future.waitForFinished();}
+
+	int zoom() const {return _zoom;}
+	const QList<IMG::RasterTile> &tiles() const {return _tiles;}
+	bool intersects(const QRectF &rect) const
+	{
+		for (int i = 0; i < _tiles.size(); i++)
+			if (rect.intersects(_tiles.at(i).rect()))
+				return true;
+		return false;
+	}
+
+signals:
+	void finished(IMGMapJob *job);
+
+private slots:
+	void handleFinished()
+	{
+		emit finished(this);
+
+		deleteLater();
+	}
+
+private:
+	QFutureWatcher<void> _watcher;
+	QFuture<void> _future;
+	QList<IMG::RasterTile> _tiles;
+	int _zoom;
+};
 
 class IMGMap : public Map
 {
@@ -13,7 +64,7 @@ class IMGMap : public Map
 
 public:
 	IMGMap(const QString &fileName, QObject *parent = 0);
-	~IMGMap() {qDeleteAll(_data);}
+	~IMGMap();
 
 	QString name() const {return _data.first()->name();}
 
@@ -41,11 +92,21 @@ public:
 	bool isValid() const {return _valid;}
 	QString errorString() const {return _errorString;}
 
+private slots:
+	void jobFinished(IMGMapJob *job);
+
 private:
 	Transform transform(int zoom) const;
 	void updateTransform();
+	bool isRunning(const TileCache::Key &key) const;
+	void addRunning(const QList<IMG::RasterTile> &tiles);
+	void removeRunning(const QList<IMG::RasterTile> &tiles);
+	void cancelJobs(const QRectF &rect);
+	void waitForJobs();
+	void dropJobs();
 
 	QList<IMG::MapData *> _data;
+	QList<RenderCache> _renderCache;
 	int _zoom;
 	Projection _projection;
 	Transform _transform;
@@ -54,6 +115,10 @@ private:
 
 	bool _valid;
 	QString _errorString;
+
+	TileCache::Partition _cache;
+	QSet<TileCache::Key> _running;
+	QList<IMGMapJob*> _jobs;
 };
 
 #endif // IMGMAP_H
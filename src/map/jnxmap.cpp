@@ -1,7 +1,6 @@
 #include <QtEndian>
 #include <QPainter>
 #include <QFileInfo>
-#include <QPixmapCache>
 #include "common/util.h"
 #include "rectd.h"
 #include "gcs.h"
@@ -19,11 +18,17 @@ struct Level {
 
 struct Ctx {
 	QPainter *painter;
-	QFile *file;
+	TileCache::Partition *cache;
+	FilePool *pool;
+	FileTileLoader *loader;
+	QList<FileTile> *tiles;
 	qreal ratio;
+	bool block;
 
-	Ctx(QPainter *painter, QFile *file, qreal ratio)
-	  : painter(painter), file(file), ratio(ratio) {}
+	Ctx(QPainter *painter, TileCache::Partition *cache, FilePool *pool,
+	  FileTileLoader *loader, QList<FileTile> *tiles, qreal ratio, bool block)
+	  : painter(painter), cache(cache), pool(pool), loader(loader),
+	  tiles(tiles), ratio(ratio), block(block) {}
 };
 
 
@@ -133,8 +138,11 @@ bool JNXMap::readTiles()
 
 JNXMap::JNXMap(const QString &fileName, const Projection &proj, QObject *parent)
   : Map(fileName, parent), _file(fileName), _zoom(0), _projection(proj),
-  _mapRatio(1.0), _valid(false)
+  _mapRatio(1.0), _cache(fileName), _pool(fileName), _loader(&_cache),
+  _valid(false)
 {
+	connect(&_loader, &FileTileLoader::loaded, this, &Map::tilesLoaded);
+
 	if (!_file.open(QIODevice::ReadOnly)) {
 		_errorString = fileName + ": " + _file.errorString();
 		return;
@@ -152,17 +160,14 @@ JNXMap::JNXMap(const QString &fileName, const Projection &proj, QObject *parent)
 
 JNXMap::~JNXMap()
 {
+	_loader.wait();
 	qDeleteAll(_zooms);
 }
 
-void JNXMap::load()
-{
-	_file.open(QIODevice::ReadOnly);
-}
-
 void JNXMap::unload()
 {
-	_file.close();
+	_loader.wait();
+	_pool.clear();
 }
 
 QPointF JNXMap::ll2xy(const Coordinates &c)
@@ -214,46 +219,51 @@ int JNXMap::zoomOut()
 	return _zoom;
 }
 
-QPixmap JNXMap::pixmap(const Tile *tile, QFile *file)
+QPixmap JNXMap::pixmap(const FileTile &tile, QFile *file)
 {
-	QPixmap pm;
-
-	QString key = file->fileName() + "-" + QString::number(tile->offset);
-	if (!QPixmapCache::find(key, &pm)) {
-		QByteArray ba;
-		ba.resize(tile->size + 2);
-		ba[0] = (char)0xFF;
-		ba[1] = (char)0xD8;
-		char *data = ba.data() + 2;
-
-		if (!file->seek(tile->offset))
-			return QPixmap();
-		if (!file->read(data, tile->size))
-			return QPixmap();
-		pm = QPixmap::fromImage(QImage::fromData(ba));
-
-		if (!pm.isNull())
-			QPixmapCache::insert(key, pm);
-	}
-
-	return pm;
+	QByteArray ba;
+	ba.resize(tile.size() + 2);
+	ba[0] = (char)0xFF;
+	ba[1] = (char)0xD8;
+	char *data = ba.data() + 2;
+
+	if (!file->seek(tile.offset()))
+		return QPixmap();
+	if (file->read(data, tile.size()) < (qint64)tile.size())
+		return QPixmap();
+
+	return QPixmap::fromImage(QImage::fromData(ba));
 }
 
 bool JNXMap::cb(Tile *tile, void *context)
 {
 	Ctx *ctx = static_cast<Ctx*>(context);
-	QPixmap pm(pixmap(tile, ctx->file));
-	pm.setDevicePixelRatio(ctx->ratio);
-	ctx->painter->drawPixmap(tile->pos / ctx->ratio, pm);
+	/* The tile data offset is unique within the file */
+	TileCache::Key key(0, (int)tile->offset, 0);
+	QPointF pos(tile->pos / ctx->ratio);
+	QPixmap pm;
+
+	if (!ctx->block && ctx->loader->isRunning(key))
+		return true;
+
+	if (ctx->cache->find(key, &pm)) {
+		pm.setDevicePixelRatio(ctx->ratio);
+		ctx->painter->drawPixmap(pos, pm);
+	} else {
+		FileTile ft(key, pos, ctx->ratio, pixmap, 0, ctx->pool);
+		ft.setOffset(tile->offset, tile->size);
+		ctx->tiles->append(ft);
+	}
 
 	return true;
 }
 
 void JNXMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
 	const RTree<Tile*, qreal, 2> &tree = _zooms.at(_zoom)->tree;
-	Ctx ctx(painter, &_file, _mapRatio);
+	QList<FileTile> tiles;
+	Ctx ctx(painter, &_cache, &_pool, &_loader, &tiles, _mapRatio,
+	  flags.testFlag(Map::Block));
 	QRectF rr(rect.topLeft() * _mapRatio, rect.size() * _mapRatio);
 
 	qreal min[2], max[2];
@@ -262,6 +272,8 @@ void JNXMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 	max[0] = rr.right();
 	max[1] = rr.bottom();
 	tree.Search(min, max, cb, &ctx);
+
+	_loader.load(tiles, painter, flags);
 }
 
 void JNXMap::setInputProjection(const Projection &projection)
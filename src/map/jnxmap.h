@@ -7,6 +7,8 @@
 #include "common/rectc.h"
 #include "transform.h"
 #include "projection.h"
+#include "tilecache.h"
+#include "filetile.h"
 #include "map.h"
 
 class JNXMap : public Map
@@ -30,7 +32,6 @@ public:
 	QPointF ll2xy(const Coordinates &c);
 	Coordinates xy2ll(const QPointF &p);
 
-	void load();
 	void unload();
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
@@ -63,7 +64,7 @@ private:
 	bool readTiles();
 
 	static bool cb(Tile *tile, void *context);
-	static QPixmap pixmap(const Tile *tile, QFile *file);
+	static QPixmap pixmap(const FileTile &tile, QFile *file);
 
 	QFile _file;
 	QList<Zoom*> _zooms;
@@ -71,6 +72,9 @@ private:
 	RectC _bounds;
 	Projection _projection;
 	qreal _mapRatio;
+	TileCache::Partition _cache;
+	FilePool _pool;
+	FileTileLoader _loader;
 
 	bool _valid;
 	QString _errorString;
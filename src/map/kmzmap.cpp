@@ -82,7 +82,7 @@ void KMZMap::Overlay::load(QZipReader *zip)
 {
 	if (!_img) {
 		QByteArray ba(zip->fileData(_path));
-		_img = new Image(QImage::fromData(ba));
+		_img = new Image(QImage::fromData(ba), _path);
 		_img->setDevicePixelRatio(_ratio);
 	}
 }
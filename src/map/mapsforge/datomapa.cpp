@@ -16,17 +16,19 @@ static uint pointType(const QVector<DatoMapa::Tag> &tags)
 {
 	for (int i = 0; i < tags.size(); i++) {
 		const DatoMapa::Tag &tag = tags.at(i);
-		if (tag.key == "place") {
-			if (tag.value == "country")
-				return 4;
-			else if (tag.value == "city")
-				return 3;
-			else if (tag.value == "town")
-				return 2;
-			else if (tag.value == "village")
-				return 1;
-			else
-				return 0;
+		if (tag.key == Diccionario::Place) {
+			switch (tag.value) {
+				case Diccionario::Country:
+					return 4;
+				case Diccionario::City:
+					return 3;
+				case Diccionario::Town:
+					return 2;
+				case Diccionario::Village:
+					return 1;
+				default:
+					return 0;
+			}
 		}
 	}
 
@@ -35,28 +37,35 @@ static uint pointType(const QVector<DatoMapa::Tag> &tags)
 
 static void setPointId(DatoMapa::Point &p)
 {
-	uint hash = (uint)qHash(QPair<double,double>((uint)qHash(
-	  QPair<double, double>(p.coordinates.lon(), p.coordinates.lat())),
-	  (uint)qHash(p.label)));
+	uint hash = (uint)qHash(QPair<double, double>(p.coordinates.lon(),
+	  p.coordinates.lat()));
 	uint type = pointType(p.tags);
 
 	p.id = ((quint64)type)<<32 | hash;
 }
 
-static void copyPaths(const RectC &rect, const QList<DatoMapa::Path> *src,
-  QList<DatoMapa::Path> *dst)
+static DatoMapa::PathSpan pathSpan(const RectC &rect,
+  const DatoMapa::PathBlock &block)
 {
-	for (int i = 0; i < src->size(); i++)
-		if (rect.intersects(src->at(i).poly.boundingRect()))
-			dst->append(src->at(i));
+	DatoMapa::PathSpan span(block);
+
+	for (int i = 0; i < block->size(); i++)
+		if (rect.intersects(block->at(i).poly.boundingRect()))
+			span.items.append(i);
+
+	return span;
 }
 
-static void copyPoints(const RectC &rect, const QList<DatoMapa::Point> *src,
-  QList<DatoMapa::Point> *dst)
+static DatoMapa::PointSpan pointSpan(const RectC &rect,
+  const DatoMapa::PointBlock &block)
 {
-	for (int i = 0; i < src->size(); i++)
-		if (rect.contains(src->at(i).coordinates))
-			dst->append(src->at(i));
+	DatoMapa::PointSpan span(block);
+
+	for (int i = 0; i < block->size(); i++)
+		if (rect.contains(block->at(i).coordinates))
+			span.items.append(i);
+
+	return span;
 }
 
 static double distance(const Coordinates &c1, const Coordinates &c2)
@@ -71,12 +80,20 @@ static bool isClosed(const Polygon &poly)
 	return (distance(poly.first().first(), poly.first().last()) < 0.000000001);
 }
 
+static void addString(quint32 key, const QByteArray &value,
+  QVector<DatoMapa::Tag> &tags, QVector<QByteArray> &strings)
+{
+	tags.append(DatoMapa::Tag(key, STRING_VALUE | strings.size()));
+	strings.append(value);
+}
+
 static bool readTags(SubFicher &subfile, int count,
-  const QVector<DatoMapa::Tag> &tags, QVector<DatoMapa::Tag> &list)
+  const QVector<DatoMapa::Tag> &tags, QVector<DatoMapa::Tag> &list,
+  QVector<QByteArray> &strings)
 {
 	QVector<quint32> ids(count);
 
-	list.resize(count);
+	list.reserve(count);
 
 	for (int i = 0; i < count; i++) {
 		if (!subfile.readVUInt32(ids[i]))
@@ -87,44 +104,66 @@ static bool readTags(SubFicher &subfile, int count,
 
 	for (int i = 0; i < count; i++) {
 		const DatoMapa::Tag &tag = tags.at(ids.at(i));
-
-		if (tag.value.length() == 2 && tag.value.at(0) == '%') {
-			QByteArray value;
-
-			if (tag.value.at(1) == 'b') {
-				quint8 b;
-				if (!subfile.readByte(b))
+		QByteArray value;
+		qint32 i32;
+		quint32 u32;
+		quint16 u16;
+		quint8 u8;
+
+		switch (tag.value) {
+			case Diccionario::ByteValue:
+				if (!subfile.readByte(u8))
 					return false;
-				value.setNum(b);
-			} else if (tag.value.at(1) == 'i') {
-				qint32 u;
-				if (!subfile.readInt32(u))
+				value.setNum(u8);
+				break;
+			case Diccionario::IntValue:
+				if (!subfile.readInt32(i32))
 					return false;
-
-				if (tag.key.contains(":colour"))
-					value = QColor((quint32)u).name().toLatin1();
+				if (Diccionario::string(tag.key).contains(":colour"))
+					value = QColor((quint32)i32).name().toLatin1();
 				else
-					value.setNum(u);
-			} else if (tag.value.at(1) == 'f') {
-				quint32 u;
-				if (!subfile.readUInt32(u))
+					value.setNum(i32);
+				break;
+			case Diccionario::FloatValue:
+				if (!subfile.readUInt32(u32))
 					return false;
-				float *f = (float *)&u;
-				value.setNum(*f);
-			} else if (tag.value.at(1) == 'h') {
-				quint16 s;
-				if (!subfile.readUInt16(s))
+				value.setNum(*(float *)&u32);
+				break;
+			case Diccionario::ShortValue:
+				if (!subfile.readUInt16(u16))
 					return false;
-				value.setNum(s);
-			} else if (tag.value.at(1) == 's') {
+				value.setNum(u16);
+				break;
+			case Diccionario::StringValue:
 				if (!subfile.readString(value))
 					return false;
-			} else
-				value = tag.value;
+				break;
+			default:
+				list.append(tag);
+				continue;
+		}
 
-			list[i] = DatoMapa::Tag(tag.key, value);
-		} else
-			list[i] = tag;
+		addString(tag.key, value, list, strings);
+	}
+
+	return true;
+}
+
+static bool readTagTable(SubFicher &subfile, QVector<DatoMapa::Tag> &table)
+{
+	quint16 count;
+	QByteArray str;
+
+	if (!subfile.readUInt16(count))
+		return false;
+	table.resize(count);
+	for (quint16 i = 0; i < count; i++) {
+		if (!subfile.readString(str))
+			return false;
+		int sep = str.indexOf('=');
+		if (sep >= 0)
+			table[i] = DatoMapa::Tag(Diccionario::insert(str.left(sep)),
+			  Diccionario::insert(str.mid(sep + 1)));
 	}
 
 	return true;
@@ -232,9 +271,9 @@ static bool readOffset(QDataStream &stream, quint64 &offset)
 	return (stream.status() == QDataStream::Ok);
 }
 
-bool DatoMapa::readSubFiles()
+bool DatoMapa::readSubFiles(QFile &file)
 {
-	QDataStream stream(&_file);
+	QDataStream stream(&file);
 
 	for (int i = 0; i < _subFiles.size(); i++) {
 		const SubFileInfo &f = _subFiles.at(i);
@@ -281,24 +320,23 @@ bool DatoMapa::readSubFiles()
 	return true;
 }
 
-bool DatoMapa::readHeader()
+bool DatoMapa::readHeader(QFile &file)
 {
 	char magic[sizeof(MAGIC) - 1];
 	quint32 hdrSize, version;
 	quint64 fileSize, date;
 	qint32 minLat, minLon, maxLat, maxLon;
-	quint16 tags;
 	quint8 flags, zooms;
-	QByteArray projection, tag;
+	QByteArray projection;
 
 
-	if (_file.read(magic, sizeof(magic)) < (int)sizeof(magic)
+	if (file.read(magic, sizeof(magic)) < (int)sizeof(magic)
 	  || memcmp(magic, MAGIC, sizeof(magic)))
 		return false;
-	if (_file.read((char*)&hdrSize, sizeof(hdrSize)) < (qint64)sizeof(hdrSize))
+	if (file.read((char*)&hdrSize, sizeof(hdrSize)) < (qint64)sizeof(hdrSize))
 		return false;
 
-	SubFicher subfile(_file, sizeof(magic) + sizeof(hdrSize),
+	SubFicher subfile(file, sizeof(magic) + sizeof(hdrSize),
 	  qFromBigEndian(hdrSize));
 	if (!subfile.seek(0))
 		return false;
@@ -344,23 +382,8 @@ bool DatoMapa::readHeader()
 			return false;
 	}
 
-	if (!subfile.readUInt16(tags))
-		return false;
-	_pointTags.resize(tags);
-	for (quint16 i = 0; i < tags; i++) {
-		if (!subfile.readString(tag))
-			return false;
-		_pointTags[i] = tag;
-	}
-
-	if (!subfile.readUInt16(tags))
+	if (!(readTagTable(subfile, _pointTags) && readTagTable(subfile, _pathTags)))
 		return false;
-	_pathTags.resize(tags);
-	for (quint16 i = 0; i < tags; i++) {
-		if (!subfile.readString(tag))
-			return false;
-		_pathTags[i] = tag;
-	}
 
 	if (!subfile.readByte(zooms))
 		return false;
@@ -381,18 +404,18 @@ bool DatoMapa::readHeader()
 	return true;
 }
 
-DatoMapa::DatoMapa(const QString &fileName) : _file(fileName)
+DatoMapa::DatoMapa(const QString &fileName) : _fileName(fileName)
 {
-	if (!_file.open(QFile::ReadOnly)) {
-		_errorString = _file.errorString();
+	QFile file(fileName);
+
+	if (!file.open(QFile::ReadOnly)) {
+		_errorString = file.errorString();
 		return;
 	}
 
-	if (!readHeader())
+	if (!readHeader(file))
 		return;
 
-	_file.close();
-
 	_pathCache.setMaxCost(256);
 	_pointCache.setMaxCost(256);
 
@@ -418,14 +441,14 @@ RectC DatoMapa::bounds() const
 
 void DatoMapa::load()
 {
-	if (_file.open(QIODevice::ReadOnly))
-		readSubFiles();
+	QFile file(_fileName);
+
+	if (file.open(QIODevice::ReadOnly))
+		readSubFiles(file);
 }
 
 void DatoMapa::clear()
 {
-	_file.close();
-
 	_pathCache.clear();
 	_pointCache.clear();
 
@@ -449,14 +472,14 @@ void DatoMapa::clearTiles()
 bool DatoMapa::pathCb(VectorTile *tile, void *context)
 {
 	PathCTX *ctx = (PathCTX*)context;
-	ctx->data->paths(tile, ctx->rect, ctx->zoom, ctx->list);
+	ctx->data->paths(ctx->file, tile, ctx->rect, ctx->zoom, ctx->list);
 	return true;
 }
 
 bool DatoMapa::pointCb(VectorTile *tile, void *context)
 {
 	PointCTX *ctx = (PointCTX*)context;
-	ctx->data->points(tile, ctx->rect, ctx->zoom, ctx->list);
+	ctx->data->points(ctx->file, tile, ctx->rect, ctx->zoom, ctx->list);
 	return true;
 }
 
@@ -469,10 +492,15 @@ int DatoMapa::level(int zoom) const
 	return _subFiles.size() - 1;
 }
 
-void DatoMapa::points(const RectC &rect, int zoom, QList<Point> *list)
+void DatoMapa::points(const RectC &rect, int zoom, QList<PointSpan> *list)
 {
+	/* Every caller (thread) uses its own file handle */
+	QFile file(_fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+
 	int l(level(zoom));
-	PointCTX ctx(this, rect, zoom, list);
+	PointCTX ctx(this, file, rect, zoom, list);
 	double min[2], max[2];
 
 	min[0] = rect.left();
@@ -483,27 +511,44 @@ void DatoMapa::points(const RectC &rect, int zoom, QList<Point> *list)
 	_tiles.at(l)->Search(min, max, pointCb, &ctx);
 }
 
-void DatoMapa::points(const VectorTile *tile, const RectC &rect, int zoom,
-  QList<Point> *list)
+void DatoMapa::points(QFile &file, const VectorTile *tile, const RectC &rect,
+  int zoom, QList<PointSpan> *list)
 {
 	Key key(tile, zoom);
-	QList<Point> *cached = _pointCache.object(key);
+	PointBlock block;
 
-	if (!cached) {
-		QList<Point> *p = new QList<Point>();
-		if (readPoints(tile, zoom, p)) {
-			copyPoints(rect, p, list);
-			_pointCache.insert(key, p);
-		} else
+	_pointCacheLock.lock();
+	PointBlock *cached = _pointCache.object(key);
+	if (cached)
+		block = *cached;
+	_pointCacheLock.unlock();
+
+	if (!block) {
+		QVector<Point> *p = new QVector<Point>();
+		if (!readPoints(file, tile, zoom, p)) {
 			delete p;
-	} else
-		copyPoints(rect, cached, list);
+			return;
+		}
+		block = PointBlock(p);
+
+		_pointCacheLock.lock();
+		_pointCache.insert(key, new PointBlock(block));
+		_pointCacheLock.unlock();
+	}
+
+	PointSpan span(pointSpan(rect, block));
+	if (span.size())
+		list->append(span);
 }
 
-void DatoMapa::paths(const RectC &rect, int zoom, QList<Path> *list)
+void DatoMapa::paths(const RectC &rect, int zoom, QList<PathSpan> *list)
 {
+	QFile file(_fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+
 	int l(level(zoom));
-	PathCTX ctx(this, rect, zoom, list);
+	PathCTX ctx(this, file, rect, zoom, list);
 	double min[2], max[2];
 
 	min[0] = rect.left();
@@ -514,27 +559,41 @@ void DatoMapa::paths(const RectC &rect, int zoom, QList<Path> *list)
 	_tiles.at(l)->Search(min, max, pathCb, &ctx);
 }
 
-void DatoMapa::paths(const VectorTile *tile, const RectC &rect, int zoom,
-  QList<Path> *list)
+void DatoMapa::paths(QFile &file, const VectorTile *tile, const RectC &rect,
+  int zoom, QList<PathSpan> *list)
 {
 	Key key(tile, zoom);
-	QList<Path> *cached = _pathCache.object(key);
+	PathBlock block;
 
-	if (!cached) {
-		QList<Path> *p = new QList<Path>();
-		if (readPaths(tile, zoom, p)) {
-			copyPaths(rect, p, list);
-			_pathCache.insert(key, p);
-		} else
+	_pathCacheLock.lock();
+	PathBlock *cached = _pathCache.object(key);
+	if (cached)
+		block = *cached;
+	_pathCacheLock.unlock();
+
+	if (!block) {
+		QVector<Path> *p = new QVector<Path>();
+		if (!readPaths(file, tile, zoom, p)) {
 			delete p;
-	} else
-		copyPaths(rect, cached, list);
+			return;
+		}
+		block = PathBlock(p);
+
+		_pathCacheLock.lock();
+		_pathCache.insert(key, new PathBlock(block));
+		_pathCacheLock.unlock();
+	}
+
+	PathSpan span(pathSpan(rect, block));
+	if (span.size())
+		list->append(span);
 }
 
-bool DatoMapa::readPaths(const VectorTile *tile, int zoom, QList<Path> *list)
+bool DatoMapa::readPaths(QFile &file, const VectorTile *tile, int zoom,
+  QVector<Path> *list) const
 {
 	const SubFileInfo &info = _subFiles.at(level(zoom));
-	SubFicher subfile(_file, info.offset, info.size);
+	SubFicher subfile(file, info.offset, info.size);
 	int rows = info.max - info.min + 1;
 	QVector<unsigned> paths(rows);
 	quint32 blocks, unused, val, cnt = 0;
@@ -568,7 +627,7 @@ bool DatoMapa::readPaths(const VectorTile *tile, int zoom, QList<Path> *list)
 
 		p.layer = sb >> 4;
 		int tags = sb & 0x0F;
-		if (!readTags(subfile, tags, _pathTags, p.tags))
+		if (!readTags(subfile, tags, _pathTags, p.tags, p.strings))
 			return false;
 
 		if (!subfile.readByte(flags))
@@ -577,17 +636,18 @@ bool DatoMapa::readPaths(const VectorTile *tile, int zoom, QList<Path> *list)
 			if (!subfile.readString(name))
 				return false;
 			name = name.split('\r').first();
-			p.tags.append(Tag("name", name));
+			addString(Diccionario::Name, name, p.tags, p.strings);
 		}
 		if (flags & 0x40) {
 			if (!subfile.readString(houseNumber))
 				return false;
-			p.tags.append(Tag("addr:housenumber", houseNumber));
+			addString(Diccionario::HouseNumber, houseNumber, p.tags,
+			  p.strings);
 		}
 		if (flags & 0x20) {
 			if (!subfile.readString(reference))
 				return false;
-			p.tags.append(Tag("ref", reference));
+			addString(Diccionario::Ref, reference, p.tags, p.strings);
 		}
 		if (flags & 0x10) {
 			if (!(subfile.readVInt32(lat) && subfile.readVInt32(lon)))
@@ -615,10 +675,11 @@ bool DatoMapa::readPaths(const VectorTile *tile, int zoom, QList<Path> *list)
 	return true;
 }
 
-bool DatoMapa::readPoints(const VectorTile *tile, int zoom, QList<Point> *list)
+bool DatoMapa::readPoints(QFile &file, const VectorTile *tile, int zoom,
+  QVector<Point> *list) const
 {
 	const SubFileInfo &info = _subFiles.at(level(zoom));
-	SubFicher subfile(_file, info.offset, info.size);
+	SubFicher subfile(file, info.offset, info.size);
 	int rows = info.max - info.min + 1;
 	QVector<unsigned> points(rows);
 	quint32 val, unused, cnt = 0;
@@ -651,7 +712,7 @@ bool DatoMapa::readPoints(const VectorTile *tile, int zoom, QList<Point> *list)
 			return false;
 		p.layer = sb >> 4;
 		int tags = sb & 0x0F;
-		if (!readTags(subfile, tags, _pointTags, p.tags))
+		if (!readTags(subfile, tags, _pointTags, p.tags, p.strings))
 			return false;
 
 		if (!subfile.readByte(flags))
@@ -660,18 +721,20 @@ bool DatoMapa::readPoints(const VectorTile *tile, int zoom, QList<Point> *list)
 			if (!subfile.readString(name))
 				return false;
 			name = name.split('\r').first();
-			p.tags.append(Tag("name", name));
+			addString(Diccionario::Name, name, p.tags, p.strings);
 		}
 		if (flags & 0x40) {
 			if (!subfile.readString(houseNumber))
 				return false;
-			p.tags.append(Tag("addr:housenumber", houseNumber));
+			addString(Diccionario::HouseNumber, houseNumber, p.tags,
+			  p.strings);
 		}
 		if (flags & 0x20) {
 			qint32 elevation;
 			if (!subfile.readVInt32(elevation))
 				return false;
-			p.tags.append(Tag("ele", QByteArray::number(elevation)));
+			addString(Diccionario::Ele, QByteArray::number(elevation), p.tags,
+			  p.strings);
 		}
 
 		setPointId(p);
@@ -697,21 +760,26 @@ bool DatoMapa::isMapsforge(const QString &path)
 #ifndef QT_NO_DEBUG
 QDebug operator<<(QDebug dbg, const DatoMapa::Tag &tag)
 {
-	dbg.nospace() << "Tag(" << tag.key << ", " << tag.value << ")";
+	dbg.nospace() << "Tag(" << Diccionario::string(tag.key) << ", ";
+	if (tag.isString())
+		dbg << "#" << (tag.value & ~STRING_VALUE);
+	else
+		dbg << Diccionario::string(tag.value);
+	dbg << ")";
 	return dbg.space();
 }
 
 QDebug operator<<(QDebug dbg, const DatoMapa::Path &path)
 {
-	dbg.nospace() << "Path(" << path.poly.boundingRect() << ", " << path.label
-	  << ", " << path.tags << ")";
+	dbg.nospace() << "Path(" << path.poly.boundingRect() << ", " << path.tags
+	  << ")";
 	return dbg.space();
 }
 
 QDebug operator<<(QDebug dbg, const DatoMapa::Point &point)
 {
-	dbg.nospace() << "Point(" << point.coordinates << "," << point.label
-	  << ", " << point.tags << ")";
+	dbg.nospace() << "Point(" << point.coordinates << ", " << point.tags
+	  << ")";
 	return dbg.space();
 }
 #endif // QT_NO_DEBUG
@@ -3,12 +3,16 @@
 
 #include <QFile>
 #include <QCache>
-#include <QPainterPath>
+#include <QMutex>
+#include <QSharedPointer>
 #include "common/config.h"
 #include "common/rectc.h"
 #include "common/rtree.h"
 #include "common/range.h"
 #include "common/polygon.h"
+#include "diccionario.h"
+
+#define STRING_VALUE 0x80000000U
 
 class DatoMapa
 {
@@ -16,36 +20,38 @@ public:
 	DatoMapa(const QString &path);
 	~DatoMapa();
 
+	/* Tag keys and values are IDs from the global tag dictionary. Values that
+	   are specific to a single feature (names, numbers, ...) are kept in the
+	   feature's strings and the tag value is their index with the
+	   STRING_VALUE flag set. */
 	struct Tag {
-		Tag() {}
-		Tag(const QByteArray &key, const QByteArray &value)
-		  : key(key), value(value) {}
-		Tag(const QByteArray &str)
+		Tag() : key(0), value(0) {}
+		Tag(quint32 key, quint32 value) : key(key), value(value) {}
+
+		bool isString() const {return (value & STRING_VALUE);}
+		QByteArray string(const QVector<QByteArray> &strings) const
 		{
-			QList<QByteArray> l(str.split('='));
-			if (l.size() == 2) {
-				key = l.at(0);
-				value = l.at(1);
-			}
+			return isString()
+			  ? strings.at(value & ~STRING_VALUE) : Diccionario::string(value);
 		}
 
 		bool operator==(const Tag &other) const
 		  {return (key == other.key && value == other.value);}
 
-		QByteArray key;
-		QByteArray value;
+		quint32 key;
+		quint32 value;
 	};
 
 	struct Point {
+		Point() {}
 		Point(const Coordinates &c) : coordinates(c) {}
 
 		Coordinates coordinates;
 		QVector<Tag> tags;
+		QVector<QByteArray> strings;
 		int layer;
 		quint64 id;
 
-		QString label;
-
 		bool operator<(const Point &other) const
 		  {return id > other.id;}
 	};
@@ -53,24 +59,44 @@ public:
 	struct Path {
 		Polygon poly;
 		QVector<Tag> tags;
+		QVector<QByteArray> strings;
 		Coordinates labelPos;
 		int layer;
 		bool closed;
 
-		QString label;
-		QPainterPath path;
-
 		bool operator<(const Path &other) const
 		  {return layer < other.layer;}
 	};
 
+	/* Decoded map file tiles are immutable and shared between the data
+	   cache and all the users. A span holds the indexes of the block items
+	   matching the requested rectangle. */
+	typedef QSharedPointer<const QVector<Path> > PathBlock;
+	typedef QSharedPointer<const QVector<Point> > PointBlock;
+
+	template <class T>
+	struct Span {
+		Span(const QSharedPointer<const QVector<T> > &block) : block(block) {}
+
+		const T &at(int i) const {return block->at(items.at(i));}
+		int size() const {return items.size();}
+
+		QSharedPointer<const QVector<T> > block;
+		QVector<int> items;
+	};
+
+	typedef Span<Path> PathSpan;
+	typedef Span<Point> PointSpan;
+
 	RectC bounds() const;
 	Range zooms() const
 	  {return Range(_subFiles.first().min, _subFiles.last().max);}
 	int tileSize() const {return _tileSize;}
 
-	void points(const RectC &rect, int zoom, QList<Point> *list);
-	void paths(const RectC &rect, int zoom, QList<Path> *list);
+	/* points() and paths() may be called concurrently from multiple threads,
+	   but not concurrently with load()/clear() */
+	void points(const RectC &rect, int zoom, QList<PointSpan> *list);
+	void paths(const RectC &rect, int zoom, QList<PathSpan> *list);
 
 	void load();
 	void clear();
@@ -98,23 +124,27 @@ private:
 	};
 
 	struct PathCTX {
-		PathCTX(DatoMapa *data, const RectC &rect, int zoom, QList<Path> *list)
-		  : data(data), rect(rect), zoom(zoom), list(list) {}
+		PathCTX(DatoMapa *data, QFile &file, const RectC &rect, int zoom,
+		  QList<PathSpan> *list)
+		  : data(data), file(file), rect(rect), zoom(zoom), list(list) {}
 
 		DatoMapa *data;
+		QFile &file;
 		const RectC &rect;
 		int zoom;
-		QList<Path> *list;
+		QList<PathSpan> *list;
 	};
 
 	struct PointCTX {
-		PointCTX(DatoMapa *data, const RectC &rect, int zoom, QList<Point> *list)
-		  : data(data), rect(rect), zoom(zoom), list(list) {}
+		PointCTX(DatoMapa *data, QFile &file, const RectC &rect, int zoom,
+		  QList<PointSpan> *list)
+		  : data(data), file(file), rect(rect), zoom(zoom), list(list) {}
 
 		DatoMapa *data;
+		QFile &file;
 		const RectC &rect;
 		int zoom;
-		QList<Point> *list;
+		QList<PointSpan> *list;
 	};
 
 	struct Key {
@@ -128,32 +158,35 @@ private:
 
 	typedef RTree<VectorTile *, double, 2> TileTree;
 
-	bool readHeader();
-	bool readSubFiles();
+	bool readHeader(QFile &file);
+	bool readSubFiles(QFile &file);
 	void clearTiles();
 
 	int level(int zoom) const;
-	void paths(const VectorTile *tile, const RectC &rect, int zoom,
-	  QList<Path> *list);
-	void points(const VectorTile *tile, const RectC &rect, int zoom,
-	  QList<Point> *list);
-	bool readPaths(const VectorTile *tile, int zoom, QList<Path> *list);
-	bool readPoints(const VectorTile *tile, int zoom, QList<Point> *list);
+	void paths(QFile &file, const VectorTile *tile, const RectC &rect,
+	  int zoom, QList<PathSpan> *list);
+	void points(QFile &file, const VectorTile *tile, const RectC &rect,
+	  int zoom, QList<PointSpan> *list);
+	bool readPaths(QFile &file, const VectorTile *tile, int zoom,
+	  QVector<Path> *list) const;
+	bool readPoints(QFile &file, const VectorTile *tile, int zoom,
+	  QVector<Point> *list) const;
 
 	static bool pathCb(VectorTile *tile, void *context);
 	static bool pointCb(VectorTile *tile, void *context);
 
 	friend HASH_T qHash(const DatoMapa::Key &key);
 
-	QFile _file;
+	QString _fileName;
 	RectC _bounds;
 	quint16 _tileSize;
 	QVector<Tag> _pointTags, _pathTags;
 	QVector<SubFileInfo> _subFiles;
 	QList<TileTree*> _tiles;
 
-	QCache<Key, QList<Path> > _pathCache;
-	QCache<Key, QList<Point> > _pointCache;
+	QCache<Key, PathBlock> _pathCache;
+	QCache<Key, PointBlock> _pointCache;
+	QMutex _pathCacheLock, _pointCacheLock;
 
 	bool _valid;
 	QString _errorString;
@@ -0,0 +1,70 @@
+#include <QHash>
+#include <QVector>
+#include <QReadWriteLock>
+#include "diccionario.h"
+
+
+class Dictionary
+{
+public:
+	Dictionary()
+	{
+		static const char *known[] = {"", "name", "addr:housenumber", "ref",
+		  "ele", "place", "country", "city", "town", "village", "%b", "%i",
+		  "%f", "%h", "%s"};
+
+		for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++) {
+			_ids.insert(known[i], _strings.size());
+			_strings.append(known[i]);
+		}
+	}
+
+	quint32 insert(const QByteArray &str)
+	{
+		_lock.lockForRead();
+		QHash<QByteArray, quint32>::const_iterator it = _ids.find(str);
+		if (it != _ids.constEnd()) {
+			quint32 id = *it;
+			_lock.unlock();
+			return id;
+		}
+		_lock.unlock();
+
+		QWriteLocker locker(&_lock);
+		it = _ids.find(str);
+		if (it != _ids.constEnd())
+			return *it;
+		quint32 id = _strings.size();
+		_ids.insert(str, id);
+		_strings.append(str);
+
+		return id;
+	}
+
+	QByteArray string(quint32 id)
+	{
+		QReadLocker locker(&_lock);
+		return (id < (quint32)_strings.size()) ? _strings.at(id) : QByteArray();
+	}
+
+private:
+	QReadWriteLock _lock;
+	QHash<QByteArray, quint32> _ids;
+	QVector<QByteArray> _strings;
+};
+
+static Dictionary &dictionary()
+{
+	static Dictionary d;
+	return d;
+}
+
+quint32 Diccionario::insert(const QByteArray &str)
+{
+	return dictionary().insert(str);
+}
+
+QByteArray Diccionario::string(quint32 id)
+{
+	return dictionary().string(id);
+}
@@ -0,0 +1,35 @@
+#ifndef MAPSFORGE_DICCIONARIO_H
+#define MAPSFORGE_DICCIONARIO_H
+
+#include <QByteArray>
+
+/* Process-wide dictionary of the mapsforge tag keys and values. The IDs are
+   stable for the whole application run, so tags can be compared as integers
+   across all the maps and the render theme. Strings are only ever added, the
+   dictionary is thread-safe. */
+class Diccionario
+{
+public:
+	enum Known {
+		Empty = 0,
+		Name,
+		HouseNumber,
+		Ref,
+		Ele,
+		Place,
+		Country,
+		City,
+		Town,
+		Village,
+		ByteValue,
+		IntValue,
+		FloatValue,
+		ShortValue,
+		StringValue
+	};
+
+	static quint32 insert(const QByteArray &str);
+	static QByteArray string(quint32 id);
+};
+
+#endif // MAPSFORGE_DICCIONARIO_H
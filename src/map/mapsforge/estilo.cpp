@@ -3,6 +3,7 @@
 #include <QUrl>
 #include <QFileInfo>
 #include <QImageReader>
+#include <algorithm>
 #include "estilo.h"
 
 
@@ -36,7 +37,35 @@ static QImage image(const QString &path, int width, int height, qreal ratio)
 		return QImage(path);
 }
 
-bool Estilo::Rule::match(const QVector<DatoMapa::Tag> &tags) const
+Estilo::TagSet::TagSet(const Estilo &style,
+  const QVector<DatoMapa::Tag> &tags, const QVector<QByteArray> &strings)
+  : _keys(style._keys.size()), _values(style._values.size()),
+  _empty(tags.isEmpty())
+{
+	_keyIds.reserve(tags.size());
+
+	for (int i = 0; i < tags.size(); i++) {
+		const DatoMapa::Tag &tag = tags.at(i);
+
+		int key = (tag.key < (quint32)style._keyMap.size())
+		  ? style._keyMap.at(tag.key) : -1;
+		if (key >= 0) {
+			_keys.setBit(key);
+			_keyIds.append(key);
+		}
+
+		int value;
+		if (tag.isString())
+			value = style._values.value(tag.string(strings), -1);
+		else
+			value = (tag.value < (quint32)style._valueMap.size())
+			  ? style._valueMap.at(tag.value) : -1;
+		if (value >= 0)
+			_values.setBit(value);
+	}
+}
+
+bool Estilo::Rule::match(const TagSet &tags) const
 {
 	for (int i = 0; i < _filters.size(); i++)
 		if (!_filters.at(i).match(tags))
@@ -45,7 +74,7 @@ bool Estilo::Rule::match(const QVector<DatoMapa::Tag> &tags) const
 	return true;
 }
 
-bool Estilo::Rule::match(bool closed, const QVector<DatoMapa::Tag> &tags) const
+bool Estilo::Rule::match(bool closed, const TagSet &tags) const
 {
 	Closed cl = closed ? YesClosed : NoClosed;
 
@@ -59,23 +88,114 @@ bool Estilo::Rule::match(bool closed, const QVector<DatoMapa::Tag> &tags) const
 	return true;
 }
 
-bool Estilo::Rule::match(int zoom, bool closed,
-  const QVector<DatoMapa::Tag> &tags) const
+const Estilo::Rule::Filter *Estilo::Rule::indexFilter() const
 {
-	Closed cl = closed ? YesClosed : NoClosed;
+	/* A rule with a positive filter on specific keys can only match features
+	   having at least one of the keys */
+	for (int i = 0; i < _filters.size(); i++) {
+		const Filter &f = _filters.at(i);
+		if (!f.isNegative() && !f.isAnyKey())
+			return &f;
+	}
 
-	if (_type && WayType != _type)
-		return false;
-	if (!_zooms.contains(zoom))
-		return false;
-	if (_closed && cl != _closed)
-		return false;
+	return 0;
+}
 
-	for (int i = 0; i < _filters.size(); i++)
-		if (!_filters.at(i).match(tags))
-			return false;
+QVector<int> Estilo::ids(QHash<QByteArray, int> &dict,
+  const QList<QByteArray> &list, bool *any)
+{
+	QVector<int> ret;
+
+	*any = false;
+	for (int i = 0; i < list.size(); i++) {
+		const QByteArray &str = list.at(i);
+
+		if (str.isEmpty() || str == "*")
+			*any = true;
+		else {
+			QHash<QByteArray, int>::const_iterator it = dict.find(str);
+			if (it == dict.constEnd())
+				it = dict.insert(str, dict.size());
+			ret.append(*it);
+		}
+	}
 
-	return true;
+	return ret;
+}
+
+Estilo::Rule::Filter Estilo::filter(const QList<QByteArray> &keys,
+  const QList<QByteArray> &vals)
+{
+	QList<QByteArray> vc(vals);
+	bool neg = (vc.removeAll("~") > 0);
+	bool anyKey, anyVal;
+	QVector<int> k(ids(_keys, keys, &anyKey));
+	QVector<int> v(ids(_values, vc, &anyVal));
+
+	return Rule::Filter(k, anyKey, v, anyVal, neg);
+}
+
+void Estilo::map(const QHash<QByteArray, int> &ids, QVector<int> &map)
+{
+	for (QHash<QByteArray, int>::const_iterator it = ids.constBegin();
+	  it != ids.constEnd(); ++it) {
+		quint32 id = Diccionario::insert(it.key());
+		while (id >= (quint32)map.size())
+			map.append(-1);
+		map[id] = *it;
+	}
+}
+
+void Estilo::compile()
+{
+	/* Dictionary IDs assigned after the theme has been compiled can never
+	   match any theme string, so the maps only need to cover the theme's own
+	   strings */
+	map(_keys, _keyMap);
+	map(_values, _valueMap);
+
+	/* All zooms above the highest zoom limit of the rules share the same
+	   index */
+	_indexZooms = 1;
+	for (int i = 0; i < _paths.size(); i++) {
+		const Range &zooms = _paths.at(i).rule()._zooms;
+		_indexZooms = qMax(_indexZooms, zooms.min() + 1);
+		if (zooms.max() < 127)
+			_indexZooms = qMax(_indexZooms, zooms.max() + 2);
+	}
+
+	_pathIndex.resize(_indexZooms * 2);
+
+	for (int zoom = 0; zoom < _indexZooms; zoom++) {
+		for (int closed = 0; closed < 2; closed++) {
+			Rule::Closed cl = closed ? Rule::YesClosed : Rule::NoClosed;
+			PathIndex &idx = _pathIndex[zoom * 2 + closed];
+
+			for (int i = 0; i < _paths.size(); i++) {
+				const Rule &r = _paths.at(i).rule();
+
+				if (r._type && Rule::WayType != r._type)
+					continue;
+				if (!r._zooms.contains(zoom))
+					continue;
+				if (r._closed && cl != r._closed)
+					continue;
+
+				const Rule::Filter *f = r.indexFilter();
+				if (f) {
+					for (int j = 0; j < f->keys().size(); j++)
+						idx.keys[f->keys().at(j)].append(i);
+				} else
+					idx.other.append(i);
+			}
+		}
+	}
+}
+
+const Estilo::PathIndex &Estilo::pathIndex(int zoom, bool closed) const
+{
+	int z = qMin(qMax(zoom, 0), _indexZooms - 1);
+	return _pathIndex.at(z * 2 + (closed ? 1 : 0));
 }
 
 void Estilo::area(QXmlStreamReader &reader, const QString &dir, qreal ratio,
@@ -185,7 +305,7 @@ void Estilo::text(QXmlStreamReader &reader, const Rule &rule,
 	bool ok;
 
 	if (attr.hasAttribute("k"))
-		ri._key = attr.value("k").toLatin1();
+		ri._key = Diccionario::insert(attr.value("k").toLatin1());
 	if (attr.hasAttribute("fill"))
 		ri._fillColor = QColor(attr.value("fill").toString());
 	if (attr.hasAttribute("stroke"))
@@ -311,7 +431,7 @@ void Estilo::rule(QXmlStreamReader &reader, const QString &dir, qreal ratio,
 
 	QList<QByteArray> keys(attr.value("k").toLatin1().split('|'));
 	QList<QByteArray> vals(attr.value("v").toLatin1().split('|'));
-	r.addFilter(Rule::Filter(keys, vals));
+	r.addFilter(filter(keys, vals));
 
 	while (reader.readNextStartElement()) {
 		if (reader.name() == QLatin1String("rule"))
@@ -409,20 +529,37 @@ bool Estilo::loadXml(const QString &path, qreal ratio)
 	return !reader.error();
 }
 
-Estilo::Estilo(const QString &path, qreal ratio)
+Estilo::Estilo(const QString &path, qreal ratio) : _indexZooms(0)
 {
 	if (!QFileInfo::exists(path) || !loadXml(path, ratio))
 		loadXml(":/mapsforge/default.xml", ratio);
+
+	compile();
 }
 
 QVector<const Estilo::PathRender *> Estilo::paths(int zoom, bool closed,
-  const QVector<DatoMapa::Tag> &tags) const
+  const TagSet &tags) const
 {
+	const PathIndex &idx = pathIndex(zoom, closed);
+	QVector<int> rules(idx.other);
 	QVector<const PathRender*> ri;
 
-	for (int i = 0; i < _paths.size(); i++)
-		if (_paths.at(i).rule().match(zoom, closed, tags))
-			ri.append(&_paths.at(i));
+	for (int i = 0; i < tags.keys().size(); i++) {
+		QHash<int, QVector<int> >::const_iterator it
+		  = idx.keys.find(tags.keys().at(i));
+		if (it != idx.keys.constEnd())
+			rules += *it;
+	}
+
+	/* Keep the render theme order (z-order) of the instructions */
+	std::sort(rules.begin(), rules.end());
+	rules.erase(std::unique(rules.begin(), rules.end()), rules.end());
+
+	for (int i = 0; i < rules.size(); i++) {
+		const PathRender &pr = _paths.at(rules.at(i));
+		if (pr.rule().match(tags))
+			ri.append(&pr);
+	}
 
 	return ri;
 }
@@ -5,32 +5,40 @@
 #include <QList>
 #include <QPen>
 #include <QFont>
+#include <QBitArray>
+#include <QHash>
 #include "datomapa.h"
 
 class QXmlStreamReader;
 
-inline bool wcmp(const QByteArray &b1, const QByteArray &b2)
-{
-	int len = b1.length();
-
-	if (!len)
-		return true;
-	if (len != b2.length())
-		return false;
-	return !memcmp(b1.constData(), b2.constData(), len);
-}
-
 class Estilo
 {
 public:
+	/* Tags of a single feature translated to the render theme key/value IDs.
+	   Create it once per feature and use it for all the rules matching. */
+	class TagSet {
+	public:
+		TagSet() : _empty(true) {}
+		TagSet(const Estilo &style, const QVector<DatoMapa::Tag> &tags,
+		  const QVector<QByteArray> &strings);
+
+		bool isEmpty() const {return _empty;}
+		bool hasKey(int id) const {return _keys.testBit(id);}
+		bool hasValue(int id) const {return _values.testBit(id);}
+		const QVector<int> &keys() const {return _keyIds;}
+
+	private:
+		QBitArray _keys, _values;
+		QVector<int> _keyIds;
+		bool _empty;
+	};
+
 	class Rule {
 	public:
 		Rule() : _type(AnyType), _closed(AnyClosed), _zooms(0, 127) {}
 
-		bool match(const QVector<DatoMapa::Tag> &tags) const;
-		bool match(bool closed, const QVector<DatoMapa::Tag> &tags) const;
-		bool match(int zoom, bool closed,
-		  const QVector<DatoMapa::Tag> &tags) const;
+		bool match(const TagSet &tags) const;
+		bool match(bool closed, const TagSet &tags) const;
 
 	private:
 		enum Type {
@@ -47,21 +55,17 @@ public:
 			InvalidClosed = 3
 		};
 
+		/* Keys and values are stored as IDs, empty ID lists with the any flag
+		   set represent the "*" wildcard. */
 		class Filter {
 		public:
-			Filter() : _neg(false) {}
-			Filter(const QList<QByteArray> &keys, const QList<QByteArray> &vals)
-			  : _neg(false)
-			{
-				_keys = list(keys);
-
-				QList<QByteArray> vc(vals);
-				if (vc.removeAll("~"))
-					_neg = true;
-				_vals = list(vc);
-			}
+			Filter() : _anyKey(false), _anyVal(false), _neg(false) {}
+			Filter(const QVector<int> &keys, bool anyKey,
+			  const QVector<int> &vals, bool anyVal, bool neg)
+			  : _keys(keys), _vals(vals), _anyKey(anyKey), _anyVal(anyVal),
+			  _neg(neg) {}
 
-			bool match(const QVector<DatoMapa::Tag> &tags) const
+			bool match(const TagSet &tags) const
 			{
 				if (_neg) {
 					if (!keyMatches(tags))
@@ -71,49 +75,37 @@ public:
 					return (keyMatches(tags) && valueMatches(tags));
 			}
 
-			bool isTautology() const
-			{
-				return (!_neg && _keys.contains(QByteArray())
-				  && _vals.contains(QByteArray()));
-			}
+			bool isTautology() const {return (!_neg && _anyKey && _anyVal);}
+			bool isNegative() const {return _neg;}
+			bool isAnyKey() const {return _anyKey;}
+			const QVector<int> &keys() const {return _keys;}
 
 		private:
-			static QList<QByteArray> list(const QList<QByteArray> &in)
-			{
-				QList<QByteArray> out;
-
-				for (int i = 0; i < in.size(); i++) {
-					if (in.at(i) == "*")
-						out.append(QByteArray());
-					else
-						out.append(in.at(i));
-				}
-
-				return out;
-			}
-
-			bool keyMatches(const QVector<DatoMapa::Tag> &tags) const
+			bool keyMatches(const TagSet &tags) const
 			{
+				if (_anyKey)
+					return !tags.isEmpty();
 				for (int i = 0; i < _keys.size(); i++)
-					for (int j = 0; j < tags.size(); j++)
-						if (wcmp(_keys.at(i), tags.at(j).key))
-							return true;
+					if (tags.hasKey(_keys.at(i)))
+						return true;
 
 				return false;
 			}
 
-			bool valueMatches(const QVector<DatoMapa::Tag> &tags) const
+			bool valueMatches(const TagSet &tags) const
 			{
+				if (_anyVal)
+					return !tags.isEmpty();
 				for (int i = 0; i < _vals.size(); i++)
-					for (int j = 0; j < tags.size(); j++)
-						if (wcmp(_vals.at(i), tags.at(j).value))
-							return true;
+					if (tags.hasValue(_vals.at(i)))
+						return true;
 
 				return false;
 			}
 
-			QList<QByteArray> _keys;
-			QList<QByteArray> _vals;
+			QVector<int> _keys;
+			QVector<int> _vals;
+			bool _anyKey, _anyVal;
 			bool _neg;
 		};
 
@@ -134,8 +126,7 @@ public:
 			if (!filter.isTautology())
 				_filters.append(filter);
 		}
-		bool match(int zoom, Type type, Closed closed,
-		  const QVector<DatoMapa::Tag> &tags) const;
+		const Filter *indexFilter() const;
 
 		friend class Estilo;
 
@@ -186,13 +177,13 @@ public:
 	public:
 		TextRender(const Rule &rule)
 		  : Render(rule), _fillColor(Qt::black), _strokeColor(Qt::black),
-		  _strokeWidth(0) {}
+		  _strokeWidth(0), _key(Diccionario::Empty) {}
 
 		const QFont &font() const {return _font;}
 		const QColor &fillColor() const {return _fillColor;}
 		const QColor &strokeColor() const {return _strokeColor;}
 		qreal strokeWidth() const {return _strokeWidth;}
-		const QByteArray &key() const {return _key;}
+		quint32 key() const {return _key;}
 
 	private:
 		friend class Estilo;
@@ -200,7 +191,7 @@ public:
 		QColor _fillColor, _strokeColor;
 		qreal _strokeWidth;
 		QFont _font;
-		QByteArray _key;
+		quint32 _key;
 	};
 
 	class Symbol : public Render
@@ -219,7 +210,7 @@ public:
 	Estilo(const QString &path, qreal ratio);
 
 	QVector<const PathRender *> paths(int zoom, bool closed,
-	  const QVector<DatoMapa::Tag> &tags) const;
+	  const TagSet &tags) const;
 	QList<const TextRender*> pathLabels(int zoom) const;
 	QList<const TextRender*> pointLabels(int zoom) const;
 	QList<const TextRender*> areaLabels(int zoom) const;
@@ -227,10 +218,32 @@ public:
 	QList<const Symbol*> areaSymbols(int zoom) const;
 
 private:
+	/* Path rules applicable for a given zoom and closed flag, bucketed by
+	   the tag keys they require. Rules that can not be bound to a key
+	   (wildcard or negative filters only) are in other. */
+	struct PathIndex {
+		QHash<int, QVector<int> > keys;
+		QVector<int> other;
+	};
+
 	QList<PathRender> _paths;
 	QList<TextRender> _pathLabels, _pointLabels, _areaLabels;
 	QList<Symbol> _symbols;
 
+	QHash<QByteArray, int> _keys, _values;
+	/* Tag dictionary ID -> theme key/value ID */
+	QVector<int> _keyMap, _valueMap;
+	QVector<PathIndex> _pathIndex;
+	int _indexZooms;
+
+	Rule::Filter filter(const QList<QByteArray> &keys,
+	  const QList<QByteArray> &vals);
+	static QVector<int> ids(QHash<QByteArray, int> &dict,
+	  const QList<QByteArray> &list, bool *any);
+	static void map(const QHash<QByteArray, int> &ids, QVector<int> &map);
+	void compile();
+	const PathIndex &pathIndex(int zoom, bool closed) const;
+
 	bool loadXml(const QString &path, qreal ratio);
 	void rendertheme(QXmlStreamReader &reader, const QString &dir, qreal ratio);
 	void layer(QXmlStreamReader &reader, QSet<QString> &cats);
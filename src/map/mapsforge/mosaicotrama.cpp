@@ -1,9 +1,9 @@
 #include <QPainter>
-#include <QCache>
 #include "common/programpaths.h"
 #include "map/mapsforgemap.h"
 #include "map/textpathitem.h"
 #include "map/textpointitem.h"
+#include "map/rendercache.h"
 #include "mosaicotrama.h"
 
 static const Estilo& style(qreal ratio)
@@ -42,15 +42,19 @@ static QPointF centroid(const QPainterPath &polygon)
 	return QPointF(cx * factor, cy * factor);
 }
 
-static QString *pointLabel(const Estilo::TextRender *ri, DatoMapa::Point &point)
+static QString *pointLabel(const Estilo::TextRender *ri,
+  const DatoMapa::Point *data, QString &label)
 {
-	for (int i = 0; i < point.tags.size(); i++) {
-		if (point.tags.at(i).key == ri->key()) {
-			if (point.tags.at(i).value.isEmpty())
+	for (int i = 0; i < data->tags.size(); i++) {
+		const DatoMapa::Tag &tag = data->tags.at(i);
+
+		if (tag.key == ri->key()) {
+			QByteArray value(tag.string(data->strings));
+			if (value.isEmpty())
 				return 0;
 			else {
-				point.label = point.tags.at(i).value;
-				return &point.label;
+				label = value;
+				return &label;
 			}
 		}
 	}
@@ -58,18 +62,21 @@ static QString *pointLabel(const Estilo::TextRender *ri, DatoMapa::Point &point)
 	return 0;
 }
 
-static QString *pathLabel(const Estilo::TextRender *ri, DatoMapa::Path &path,
-  bool *limit = 0)
+static QString *pathLabel(const Estilo::TextRender *ri,
+  const DatoMapa::Path *data, QString &label, bool *limit = 0)
 {
-	for (int i = 0; i < path.tags.size(); i++) {
-		if (path.tags.at(i).key == ri->key()) {
-			if (path.tags.at(i).value.isEmpty())
+	for (int i = 0; i < data->tags.size(); i++) {
+		const DatoMapa::Tag &tag = data->tags.at(i);
+
+		if (tag.key == ri->key()) {
+			QByteArray value(tag.string(data->strings));
+			if (value.isEmpty())
 				return 0;
 			else {
-				path.label = path.tags.at(i).value;
+				label = value;
 				if (limit)
-					*limit = (path.tags.at(i).key == "ref");
-				return &path.label;
+					*limit = (tag.key == Diccionario::Ref);
+				return &label;
 			}
 		}
 	}
@@ -91,15 +98,16 @@ void MosaicoTrama::processPointLabels(QList<TextItem*> &textItems)
 	QList<const Estilo::Symbol*> symbols(s.pointSymbols(_zoom));
 
 	for (int i = 0; i < _points.size(); i++) {
-		DatoMapa::Point &point = _points[i];
+		Point &point = _points[i];
+		Estilo::TagSet tags(s, point.data->tags, point.data->strings);
 		QString *label = 0;
 		const Estilo::TextRender *ti = 0;
 		const Estilo::Symbol *si = 0;
 
 		for (int j = 0; j < labels.size(); j++) {
 			const Estilo::TextRender *ri = labels.at(j);
-			if (ri->rule().match(point.tags)) {
-				if ((label = pointLabel(ri, point))) {
+			if (ri->rule().match(tags)) {
+				if ((label = pointLabel(ri, point.data, point.label))) {
 					ti = ri;
 					break;
 				}
@@ -108,7 +116,7 @@ void MosaicoTrama::processPointLabels(QList<TextItem*> &textItems)
 
 		for (int j = 0; j < symbols.size(); j++) {
 			const Estilo::Symbol *ri = symbols.at(j);
-			if (ri->rule().match(point.tags)) {
+			if (ri->rule().match(tags)) {
 				si = ri;
 				break;
 			}
@@ -123,7 +131,7 @@ void MosaicoTrama::processPointLabels(QList<TextItem*> &textItems)
 		const QColor *hColor = ti ? haloColor(ti) : 0;
 
 		TextPointItem *item = new TextPointItem(
-		  ll2xy(point.coordinates).toPoint(), label, font, img, color,
+		  ll2xy(point.data->coordinates).toPoint(), label, font, img, color,
 		    hColor, 0, false);
 		if (item->isValid() && !item->collides(textItems))
 			textItems.append(item);
@@ -139,18 +147,20 @@ void MosaicoTrama::processAreaLabels(QList<TextItem*> &textItems)
 	QList<const Estilo::Symbol*> symbols(s.areaSymbols(_zoom));
 
 	for (int i = 0; i < _paths.size(); i++) {
-		DatoMapa::Path &path = _paths[i];
+		Path &path = _paths[i];
 		QString *label = 0;
 		const Estilo::TextRender *ti = 0;
 		const Estilo::Symbol *si = 0;
 
-		if (!path.closed)
+		if (!path.data->closed)
 			continue;
 
+		Estilo::TagSet tags(s, path.data->tags, path.data->strings);
+
 		for (int j = 0; j < labels.size(); j++) {
 			const Estilo::TextRender *ri = labels.at(j);
-			if (ri->rule().match(path.closed, path.tags)) {
-				if ((label = pathLabel(ri, path))) {
+			if (ri->rule().match(path.data->closed, tags)) {
+				if ((label = pathLabel(ri, path.data, path.label))) {
 					ti = ri;
 					break;
 				}
@@ -159,7 +169,7 @@ void MosaicoTrama::processAreaLabels(QList<TextItem*> &textItems)
 
 		for (int j = 0; j < symbols.size(); j++) {
 			const Estilo::Symbol *ri = symbols.at(j);
-			if (ri->rule().match(path.tags)) {
+			if (ri->rule().match(tags)) {
 				si = ri;
 				break;
 			}
@@ -169,14 +179,14 @@ void MosaicoTrama::processAreaLabels(QList<TextItem*> &textItems)
 			continue;
 
 		if (!path.path.elementCount())
-			path.path = painterPath(path.poly);
+			path.path = painterPath(path.data->poly);
 
 		const QImage *img = si ? &si->img() : 0;
 		const QFont *font = ti ? &ti->font() : 0;
 		const QColor *color = ti ? &ti->fillColor() : 0;
 		const QColor *hColor = ti ? haloColor(ti) : 0;
-		QPointF pos = path.labelPos.isNull()
-		  ? centroid(path.path) : ll2xy(path.labelPos);
+		QPointF pos = path.data->labelPos.isNull()
+		  ? centroid(path.path) : ll2xy(path.data->labelPos);
 
 		TextPointItem *item = new TextPointItem(pos.toPoint(), label, font, img,
 		  color, hColor, 0, false);
@@ -194,19 +204,28 @@ void MosaicoTrama::processLineLabels(QList<TextItem*> &textItems)
 	QList<const Estilo::TextRender*> instructions(s.pathLabels(_zoom));
 	QSet<QString> set;
 
+	if (instructions.isEmpty())
+		return;
+
+	QVector<Estilo::TagSet> tags;
+	tags.reserve(_paths.size());
+	for (int i = 0; i < _paths.size(); i++)
+		tags.append(Estilo::TagSet(s, _paths.at(i).data->tags,
+		  _paths.at(i).data->strings));
+
 	for (int i = 0; i < instructions.size(); i++) {
 		const Estilo::TextRender *ri = instructions.at(i);
 
 		for (int j = 0; j < _paths.size(); j++) {
-			DatoMapa::Path &path = _paths[j];
+			Path &path = _paths[j];
 			QString *label = 0;
 			bool limit = false;
 
 			if (!path.path.elementCount())
 				continue;
-			if (!ri->rule().match(path.closed, path.tags))
+			if (!ri->rule().match(path.data->closed, tags.at(j)))
 				continue;
-			if (!(label = pathLabel(ri, path, &limit)))
+			if (!(label = pathLabel(ri, path.data, path.label, &limit)))
 				continue;
 			if (limit && set.contains(path.label))
 				continue;
@@ -247,26 +266,16 @@ QPainterPath MosaicoTrama::painterPath(const Polygon &polygon) const
 
 QVector<MosaicoTrama::PathInstruction> MosaicoTrama::pathInstructions()
 {
-	QCache<Key, QVector<const Estilo::PathRender *> > cache(1024);
 	QVector<PathInstruction> instructions;
 	const Estilo &s = style(_ratio);
-	QVector<const Estilo::PathRender*> *ri;
 
 	for (int i = 0 ; i < _paths.size(); i++) {
-		DatoMapa::Path &path = _paths[i];
-
-		Key key(_zoom, path.closed, path.tags);
-		QVector<const Estilo::PathRender*> *cached = cache.object(key);
-		if (!cached) {
-			ri = new QVector<const Estilo::PathRender*>(s.paths(_zoom,
-			  path.closed, path.tags));
-			for (int j = 0; j < ri->size(); j++)
-				instructions.append(PathInstruction(ri->at(j), &path));
-			cache.insert(key, ri);
-		} else {
-			for (int j = 0; j < cached->size(); j++)
-				instructions.append(PathInstruction(cached->at(j), &path));
-		}
+		Path &path = _paths[i];
+		QVector<const Estilo::PathRender*> ri(s.paths(_zoom, path.data->closed,
+		  Estilo::TagSet(s, path.data->tags, path.data->strings)));
+
+		for (int j = 0; j < ri.size(); j++)
+			instructions.append(PathInstruction(ri.at(j), &path));
 	}
 
 	std::sort(instructions.begin(), instructions.end());
@@ -298,7 +307,7 @@ void MosaicoTrama::drawPaths(QPainter *painter)
 		}
 
 		if (!is.path()->path.elementCount())
-			is.path()->path = painterPath(is.path()->poly);
+			is.path()->path = painterPath(is.path()->data->poly);
 
 		if (ri->area()) {
 			lp.setPen(ri->pen(_zoom));
@@ -319,6 +328,23 @@ void MosaicoTrama::drawPaths(QPainter *painter)
 
 void MosaicoTrama::render()
 {
+	if (RenderCache::load(_cacheFile, _ratio, _pixmap))
+		return;
+
+	_data->paths(_pathRect, _zoom, &_pathSpans);
+	_data->points(_pointRect, _zoom, &_pointSpans);
+
+	for (int i = 0; i < _pathSpans.size(); i++) {
+		const DatoMapa::PathSpan &span = _pathSpans.at(i);
+		for (int j = 0; j < span.size(); j++)
+			_paths.append(Path(&span.at(j)));
+	}
+	for (int i = 0; i < _pointSpans.size(); i++) {
+		const DatoMapa::PointSpan &span = _pointSpans.at(i);
+		for (int j = 0; j < span.size(); j++)
+			_points.append(Point(&span.at(j)));
+	}
+
 	std::sort(_points.begin(), _points.end());
 
 	QList<TextItem*> textItems;
@@ -342,4 +368,7 @@ void MosaicoTrama::render()
 	//painter.drawRect(QRect(_rect.topLeft(), _pixmap.size()));
 
 	qDeleteAll(textItems);
+
+	painter.end();
+	RenderCache::save(_cacheFile, _pixmap);
 }
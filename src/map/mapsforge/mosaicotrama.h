@@ -2,8 +2,10 @@
 #define MAPSFORGE_MOSAICOTRAMA_H
 
 #include <QPixmap>
+#include <QPainterPath>
 #include "map/projection.h"
 #include "map/transform.h"
+#include "map/tilecache.h"
 #include "estilo.h"
 #include "datomapa.h"
 
@@ -12,58 +14,67 @@ class TextItem;
 class MosaicoTrama
 {
 public:
-	MosaicoTrama(const Projection &proj, const Transform &transform, int zoom,
-	  const QRect &rect, qreal ratio, const QString &key,
-	  const QList<DatoMapa::Path> &paths, const QList<DatoMapa::Point> &points)
-	  : _proj(proj), _transform(transform), _zoom(zoom), _rect(rect),
-	  _ratio(ratio), _key(key), _pixmap(rect.width() * ratio,
-	  rect.height() * ratio), _paths(paths), _points(points) {}
-
-	const QString &key() const {return _key;}
+	MosaicoTrama(const Projection &proj, const Transform &transform,
+	  DatoMapa *data, int zoom, const QRect &rect, qreal ratio,
+	  const TileCache::Key &key, const RectC &pathRect,
+	  const RectC &pointRect)
+	  : _proj(proj), _transform(transform), _data(data), _zoom(zoom),
+	  _rect(rect), _ratio(ratio), _key(key), _pixmap(rect.width() * ratio,
+	  rect.height() * ratio), _pathRect(pathRect), _pointRect(pointRect) {}
+
+	const TileCache::Key &key() const {return _key;}
 	QPoint xy() const {return _rect.topLeft();}
 	const QPixmap &pixmap() const {return _pixmap;}
 
+	void setCacheFile(const QString &file) {_cacheFile = file;}
+
 	void render();
 
 private:
+	/* Per tile render state of the shared (immutable) map data features */
+	struct Path {
+		Path() : data(0) {}
+		Path(const DatoMapa::Path *data) : data(data) {}
+
+		const DatoMapa::Path *data;
+		QString label;
+		QPainterPath path;
+	};
+
+	struct Point {
+		Point() : data(0) {}
+		Point(const DatoMapa::Point *data) : data(data) {}
+
+		bool operator<(const Point &other) const
+		  {return *data < *other.data;}
+
+		const DatoMapa::Point *data;
+		QString label;
+	};
+
 	class PathInstruction
 	{
 	public:
 		PathInstruction() : _render(0), _path(0) {}
-		PathInstruction(const Estilo::PathRender *render, DatoMapa::Path *path)
+		PathInstruction(const Estilo::PathRender *render, Path *path)
 		  : _render(render), _path(path) {}
 
 		bool operator<(const PathInstruction &other) const
 		{
-			if (_path->layer == other._path->layer)
+			if (_path->data->layer == other._path->data->layer)
 				return _render->zOrder() < other._render->zOrder();
 			else
-				return (_path->layer < other._path->layer);
+				return (_path->data->layer < other._path->data->layer);
 		}
 
 		const Estilo::PathRender *render() const {return _render;}
-		DatoMapa::Path *path() {return _path;}
+		Path *path() {return _path;}
 
 	private:
 		const Estilo::PathRender *_render;
-		DatoMapa::Path *_path;
-	};
-
-	struct Key {
-		Key(int zoom, bool closed, const QVector<DatoMapa::Tag> &tags)
-		  : zoom(zoom), closed(closed), tags(tags) {}
-		bool operator==(const Key &other) const
-		{
-			return zoom == other.zoom && closed == other.closed
-			  && tags == other.tags;
-		}
-
-		int zoom;
-		bool closed;
-		const QVector<DatoMapa::Tag> &tags;
+		Path *_path;
 	};
 
-	friend HASH_T qHash(const MosaicoTrama::Key &key);
 	friend HASH_T qHash(const MosaicoTrama::PathInstruction &pi);
 
 	QVector<PathInstruction> pathInstructions();
@@ -78,18 +89,18 @@ private:
 
 	Projection _proj;
 	Transform _transform;
+	DatoMapa *_data;
 	int _zoom;
 	QRect _rect;
 	qreal _ratio;
-	QString _key;
+	TileCache::Key _key;
+	QString _cacheFile;
 	QPixmap _pixmap;
-	QList<DatoMapa::Path> _paths;
-	QList<DatoMapa::Point> _points;
+	RectC _pathRect, _pointRect;
+	QList<DatoMapa::PathSpan> _pathSpans;
+	QList<DatoMapa::PointSpan> _pointSpans;
+	QVector<Path> _paths;
+	QVector<Point> _points;
 };
 
-inline HASH_T qHash(const MosaicoTrama::Key &key)
-{
-	return ::qHash(key.zoom) ^ ::qHash(key.tags);
-}
-
 #endif // MAPSFORGE_MOSAICOTRAMA_H
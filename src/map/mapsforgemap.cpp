@@ -1,5 +1,6 @@
 #include <QPainter>
 #include "common/wgs84.h"
+#include "common/programpaths.h"
 #include "pcs.h"
 #include "rectd.h"
 #include "mapsforgemap.h"
@@ -19,13 +20,19 @@ static int log2i(unsigned val)
 }
 
 MapsforgeMap::MapsforgeMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _data(fileName), _zoom(0),
-  _projection(PCS::pcs(3857)), _tileRatio(1.0)
+  : Map(fileName, parent), _data(fileName),
+  _renderCache(fileName, ProgramPaths::renderthemeFile()), _zoom(0),
+  _projection(PCS::pcs(3857)), _tileRatio(1.0), _cache(fileName)
 {
 	_zoom = _data.zooms().min();
 	updateTransform();
 }
 
+MapsforgeMap::~MapsforgeMap()
+{
+	waitForJobs();
+}
+
 void MapsforgeMap::load()
 {
 	_data.load();
@@ -33,6 +40,7 @@ void MapsforgeMap::load()
 
 void MapsforgeMap::unload()
 {
+	waitForJobs();
 	_data.clear();
 }
 
@@ -100,7 +108,7 @@ void MapsforgeMap::updateTransform()
 		_bounds.adjust(0.5, 0, -0.5, 0);
 }
 
-bool MapsforgeMap::isRunning(const QString &key) const
+bool MapsforgeMap::isRunning(const TileCache::Key &key) const
 {
 	return _running.contains(key);
 }
@@ -117,9 +125,38 @@ void MapsforgeMap::removeRunning(const QList<MosaicoTrama> &tiles)
 		_running.remove(tiles.at(i).key());
 }
 
-void MapsforgeMap::jobFinished(const QList<MosaicoTrama> &tiles)
+void MapsforgeMap::waitForJobs()
+{
+	/* The jobs read the map data, so they must not outlive it */
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->wait();
+}
+
+/* The jobs are stopped and their results discarded, used when the rendered
+   tiles would not match the map setup anymore */
+void MapsforgeMap::dropJobs()
 {
-	removeRunning(tiles);
+	for (int i = 0; i < _jobs.size(); i++) {
+		_jobs.at(i)->cancel();
+		_jobs.at(i)->wait();
+		_jobs.at(i)->disconnect(this);
+	}
+	_jobs.clear();
+	_running.clear();
+}
+
+void MapsforgeMap::jobFinished(MapsforgeMapJob *job)
+{
+	const QList<MosaicoTrama> &tiles = job->tiles();
+
+	for (int i = 0; i < tiles.size(); i++) {
+		const MosaicoTrama &mt = tiles.at(i);
+		if (!mt.pixmap().isNull())
+			_cache.insert(mt.key(), mt.pixmap());
+	}
+
+	_jobs.removeOne(job);
+	removeRunning(job->tiles());
 	emit tilesLoaded();
 }
 
@@ -134,24 +171,21 @@ void MapsforgeMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 	int height = ceil(s.height() / _data.tileSize());
 
 	QList<MosaicoTrama> tiles;
+	QString cachePath(_renderCache.path(_zoom, _projection, _tileRatio));
 
 	for (int i = 0; i < width; i++) {
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint ttl(tl.x() + i * _data.tileSize(), tl.y() + j
 			  * _data.tileSize());
-			QString key = path() + "-" + QString::number(_zoom) + "_"
-			  + QString::number(ttl.x()) + "_" + QString::number(ttl.y());
+			TileCache::Key key(_zoom, ttl.x(), ttl.y());
 
 			if (isRunning(key))
 				continue;
 
-			if (QPixmapCache::find(key, &pm))
+			if (_cache.find(key, &pm))
 				painter->drawPixmap(ttl, pm);
 			else {
-				QList<DatoMapa::Path> paths;
-				QList<DatoMapa::Point> points;
-
 				/* Add a "sub-pixel" margin to assure the tile areas do not
 				   overlap on the border lines. This prevents areas overlap
 				   artifacts at least when using the EPSG:3857 projection. */
@@ -161,7 +195,6 @@ void MapsforgeMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 				pathRect &= _bounds;
 				RectD pathRectD(_transform.img2proj(pathRect.topLeft()),
 				  _transform.img2proj(pathRect.bottomRight()));
-				_data.paths(pathRectD.toRectC(_projection, 20), _zoom, &paths);
 
 				QRectF pointRect(QPointF(ttl.x() - TEXT_EXTENT, ttl.y()
 				  - TEXT_EXTENT), QPointF(ttl.x() + _data.tileSize()
@@ -169,12 +202,13 @@ void MapsforgeMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 				pointRect &= _bounds;
 				RectD pointRectD(_transform.img2proj(pointRect.topLeft()),
 				  _transform.img2proj(pointRect.bottomRight()));
-				_data.points(pointRectD.toRectC(_projection, 20), _zoom,
-				  &points);
 
-				tiles.append(MosaicoTrama(_projection, _transform, _zoom,
+				MosaicoTrama mt(_projection, _transform, &_data, _zoom,
 				  QRect(ttl, QSize(_data.tileSize(), _data.tileSize())),
-				  _tileRatio, key, paths, points));
+				  _tileRatio, key, pathRectD.toRectC(_projection, 20),
+				  pointRectD.toRectC(_projection, 20));
+				mt.setCacheFile(RenderCache::tileFile(cachePath, ttl));
+				tiles.append(mt);
 			}
 		}
 	}
@@ -183,6 +217,7 @@ void MapsforgeMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		MapsforgeMapJob *job = new MapsforgeMapJob(tiles);
 		connect(job, &MapsforgeMapJob::finished, this,
 		  &MapsforgeMap::jobFinished);
+		_jobs.append(job);
 		addRunning(tiles);
 		job->run();
 	}
@@ -200,7 +235,9 @@ void MapsforgeMap::setOutputProjection(const Projection &projection)
 	if (projection == _projection)
 		return;
 
+	dropJobs();
+
 	_projection = projection;
 	updateTransform();
-	QPixmapCache::clear();
+	_cache.clear();
 }
@@ -2,11 +2,12 @@
 #define MAPSFORGEMAP_H
 
 #include <QtConcurrent>
-#include <QPixmapCache>
 #include "mapsforge/datomapa.h"
 #include "mapsforge/mosaicotrama.h"
 #include "projection.h"
 #include "transform.h"
+#include "rendercache.h"
+#include "tilecache.h"
 #include "map.h"
 
 
@@ -26,23 +27,18 @@ public:
 		_future = QtConcurrent::map(_tiles, &MosaicoTrama::render);
 		_watcher.setFuture(_future);
 	}
+	void cancel() {_future.cancel();}
+	void wait() {_future.waitForFinished();}
+
+	const QList<MosaicoTrama> &tiles() const {return _tiles;}
 
 signals:
-	void finished(const QList<MosaicoTrama> &);
+	void finished(MapsforgeMapJob *job);
 
 private slots:
 	void handleFinished()
 	{
-		for (int i = 0; i < _tiles.size(); i++) {
-			MosaicoTrama &mt = _tiles[i];
-			const QPixmap &pm = mt.pixmap();
-			if (pm.isNull())
-				continue;
-
-			QPixmapCache::insert(mt.key(), pm);
-		}
-
-		emit finished(_tiles);
+		emit finished(this);
 
 		deleteLater();
 	}
@@ -59,6 +55,7 @@ class MapsforgeMap : public Map
 
 public:
 	MapsforgeMap(const QString &fileName, QObject *parent = 0);
+	~MapsforgeMap();
 
 	QRectF bounds() {return _bounds;}
 	RectC llBounds() {return _data.bounds();}
@@ -85,16 +82,19 @@ public:
 	QString errorString() const {return _data.errorString();}
 
 private slots:
-	void jobFinished(const QList<MosaicoTrama> &tiles);
+	void jobFinished(MapsforgeMapJob *job);
 
 private:
 	Transform transform(int zoom) const;
 	void updateTransform();
-	bool isRunning(const QString &key) const;
+	bool isRunning(const TileCache::Key &key) const;
 	void addRunning(const QList<MosaicoTrama> &tiles);
 	void removeRunning(const QList<MosaicoTrama> &tiles);
+	void waitForJobs();
+	void dropJobs();
 
 	DatoMapa _data;
+	RenderCache _renderCache;
 	int _zoom;
 
 	Projection _projection;
@@ -102,7 +102,9 @@ private:
 	QRectF _bounds;
 	qreal _tileRatio;
 
-	QSet<QString> _running;
+	TileCache::Partition _cache;
+	QSet<TileCache::Key> _running;
+	QList<MapsforgeMapJob*> _jobs;
 };
 
 #endif // MAPSFORGEMAP_H
@@ -3,11 +3,16 @@
 #include "onlinemap.h"
 #include "wmtsmap.h"
 #include "wmsmap.h"
+#include "demmap.h"
 #include "osm.h"
 #include "invalidmap.h"
 #include "mapsource.h"
 
 
+/* Rendering the low zoom levels would require reading hundreds of DEM files
+   for a single map tile */
+#define DEM_ZOOMS Range(8, 16)
+
 MapSource::Config::Config() : type(OSM), zooms(OSM::ZOOMS), bounds(OSM::BOUNDS),
   format("image/png"), rest(false), tileRatio(1.0), tileSize(256),
   scalable(false) {}
@@ -153,6 +158,10 @@ void MapSource::map(QXmlStreamReader &reader, Config &config)
 		config.type = TMS;
 	else if (type == QLatin1String("QuadTiles"))
 		config.type = QuadTiles;
+	else if (type == QLatin1String("DEM")) {
+		config.type = DEM;
+		config.zooms = DEM_ZOOMS;
+	}
 	else if (type == QLatin1String("OSM") || type.isEmpty())
 		config.type = OSM;
 	else {
@@ -242,7 +251,7 @@ Map *MapSource::loadMap(const QString &path)
 
 	if (config.name.isEmpty())
 		return new InvalidMap(path, "Missing name definition");
-	if (config.url.isEmpty())
+	if (config.url.isEmpty() && config.type != DEM)
 		return new InvalidMap(path, "Missing URL definition");
 	if (config.type == WMTS || config.type == WMS) {
 		if (config.layer.isEmpty())
@@ -258,6 +267,11 @@ Map *MapSource::loadMap(const QString &path)
 		if (config.crs.isEmpty())
 			return new InvalidMap(path, "Missing CRS definiton");
 	}
+	if (config.type == DEM) {
+		if (!config.style.isEmpty() && config.style != "hillshade"
+		  && config.style != "relief")
+			return new InvalidMap(path, "Invalid DEM style");
+	}
 
 	switch (config.type) {
 		case WMTS:
@@ -282,6 +296,9 @@ Map *MapSource::loadMap(const QString &path)
 			return new OnlineMap(path, config.name, config.url, config.zooms,
 			 config.bounds, config.tileRatio, config.authorization,
 			 config.tileSize, config.scalable, false, true);
+		case DEM:
+			return new DEMMap(path, config.name, (config.style == "relief")
+			  ? DEMMap::Relief : DEMMap::Hillshade, config.zooms, config.bounds);
 		default:
 			return new InvalidMap(path, "Invalid map type");
 	}
@@ -23,7 +23,8 @@ private:
 		WMTS,
 		WMS,
 		TMS,
-		QuadTiles
+		QuadTiles,
+		DEM
 	};
 
 	struct Config {
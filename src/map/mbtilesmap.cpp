@@ -2,7 +2,6 @@
 #include <QSqlRecord>
 #include <QSqlField>
 #include <QPainter>
-#include <QPixmapCache>
 #include <QImageReader>
 #include <QBuffer>
 #include <QtConcurrent>
@@ -17,11 +16,11 @@ class MBTile
 {
 public:
 	MBTile(int zoom, int scaledSize, const QPoint &xy, const QByteArray &data,
-	  const QString &key) : _zoom(zoom), _scaledSize(scaledSize), _xy(xy),
+	  const TileCache::Key &key) : _zoom(zoom), _scaledSize(scaledSize), _xy(xy),
 	  _data(data), _key(key) {}
 
 	const QPoint &xy() const {return _xy;}
-	const QString &key() const {return _key;}
+	const TileCache::Key &key() const {return _key;}
 	QPixmap pixmap() const {return QPixmap::fromImage(_image);}
 
 	void load() {
@@ -39,14 +38,14 @@ private:
 	int _scaledSize;
 	QPoint _xy;
 	QByteArray _data;
-	QString _key;
+	TileCache::Key _key;
 	QImage _image;
 };
 
 
 MBTilesMap::MBTilesMap(const QString &fileName, QObject *parent)
   : Map(fileName, parent), _mapRatio(1.0), _tileRatio(1.0), _scalable(false),
-  _scaledSize(0), _valid(false)
+  _scaledSize(0), _cache(fileName), _valid(false)
 {
 	_db = QSqlDatabase::addDatabase("QSQLITE", fileName);
 	_db.setDatabaseName(fileName);
@@ -281,10 +280,9 @@ void MBTilesMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(_zoom) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			TileCache::Key key(_zoom, t.x(), t.y());
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (_cache.find(key, &pm)) {
 				QPointF tp(qMax(tl.x(), b.left()) + (t.x() - tile.x())
 				  * tileSize(), qMax(tl.y(), b.top()) + (t.y() - tile.y())
 				  * tileSize());
@@ -305,7 +303,7 @@ void MBTilesMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		if (pm.isNull())
 			continue;
 
-		QPixmapCache::insert(mt.key(), pm);
+		_cache.insert(mt.key(), pm);
 
 		QPointF tp(qMax(tl.x(), b.left()) + (mt.xy().x() - tile.x())
 		  * tileSize(), qMax(tl.y(), b.top()) + (mt.xy().y() - tile.y())
@@ -3,6 +3,7 @@
 
 #include <QSqlDatabase>
 #include "common/range.h"
+#include "tilecache.h"
 #include "map.h"
 
 class MBTilesMap : public Map
@@ -52,6 +53,7 @@ private:
 	qreal _mapRatio, _tileRatio;
 	bool _scalable;
 	int _scaledSize;
+	TileCache::Partition _cache;
 
 	bool _valid;
 	QString _errorString;
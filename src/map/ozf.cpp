@@ -197,9 +197,10 @@ bool OZF::open()
 	return true;
 }
 
-QPixmap OZF::tile(int zoom, int x, int y)
+/* The tile data are read using the file handle provided by the caller, so
+   the tiles can be loaded in parallel. */
+QPixmap OZF::tile(QFile &file, int zoom, int x, int y) const
 {
-	Q_ASSERT(_file.isOpen());
 	Q_ASSERT(0 <= zoom && zoom < _zooms.count());
 
 	const Zoom &z = _zooms.at(zoom);
@@ -209,7 +210,7 @@ QPixmap OZF::tile(int zoom, int x, int y)
 		return QPixmap();
 
 	int size = z.tiles.at(i+1) - z.tiles.at(i);
-	if (!_file.seek(z.tiles.at(i)))
+	if (!file.seek(z.tiles.at(i)))
 		return QPixmap();
 
 	quint32 bes = qToBigEndian(tileSize().width() * tileSize().height());
@@ -217,8 +218,10 @@ QPixmap OZF::tile(int zoom, int x, int y)
 	ba.resize(sizeof(bes) + size);
 	memcpy(ba.data(), &bes, sizeof(bes));
 
-	if (!read(ba.data() + sizeof(bes), size, 16))
+	if (file.read(ba.data() + sizeof(bes), size) < (qint64)size)
 		return QPixmap();
+	if (_decrypt)
+		decrypt(ba.data() + sizeof(bes), qMin(size, 16), _key);
 	QByteArray uba = qUncompress(ba);
 	if (uba.size() != tileSize().width() * tileSize().height())
 		return QPixmap();
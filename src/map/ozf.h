@@ -24,7 +24,7 @@ public:
 	QSize size(int zoom) const;
 	QPointF scale(int zoom) const;
 	QSize tileSize() const {return QSize(_tileSize, _tileSize);}
-	QPixmap tile(int zoom, int x, int y);
+	QPixmap tile(QFile &file, int zoom, int x, int y) const;
 
 	static bool isOZF(const QString &path);
 
@@ -4,7 +4,6 @@
 #include <QDir>
 #include <QBuffer>
 #include <QImageReader>
-#include <QPixmapCache>
 #include <QRegularExpression>
 #include "common/coordinates.h"
 #include "common/rectc.h"
@@ -19,14 +18,17 @@
 
 OziMap::OziMap(const QString &fileName, QObject *parent)
   : Map(fileName, parent), _img(0), _tar(0), _ozf(0), _zoom(0), _mapRatio(1.0),
-  _valid(false)
+  _cache(fileName), _pool(0), _loader(&_cache), _valid(false)
 {
+	connect(&_loader, &FileTileLoader::loaded, this, &Map::tilesLoaded);
+
 	QFileInfo fi(fileName);
 	QString suffix = fi.suffix().toLower();
 
 
 	if (suffix == "tar") {
 		_tar = new Tar(fileName);
+		_pool = new FilePool(fileName);
 		if (!_tar->open()) {
 			_errorString = "Error reading tar file";
 			return;
@@ -82,8 +84,10 @@ OziMap::OziMap(const QString &fileName, QObject *parent)
 
 OziMap::OziMap(const QString &fileName, Tar &tar, QObject *parent)
   : Map(fileName, parent), _img(0), _tar(0), _ozf(0), _zoom(0), _mapRatio(1.0),
-  _valid(false)
+  _cache(fileName), _pool(0), _loader(&_cache), _valid(false)
 {
+	connect(&_loader, &FileTileLoader::loaded, this, &Map::tilesLoaded);
+
 	QFileInfo fi(fileName);
 	QFileInfo map(fi.absolutePath());
 	QFileInfo layer(map.absolutePath());
@@ -107,12 +111,16 @@ OziMap::OziMap(const QString &fileName, Tar &tar, QObject *parent)
 	_projection = mf.projection();
 	_transform = mf.transform();
 	_tar = new Tar(fi.absolutePath() + "/" + fi.completeBaseName() + ".tar");
+	_pool = new FilePool(_tar->fileName());
 
 	_valid = true;
 }
 
 OziMap::~OziMap()
 {
+	_loader.wait();
+
+	delete _pool;
 	delete _img;
 	delete _tar;
 	delete _ozf;
@@ -147,6 +155,7 @@ bool OziMap::setImageInfo(const QString &path)
 			return false;
 		}
 		_scale = _ozf->scale(_zoom);
+		_pool = new FilePool(_map.path);
 	} else {
 		QImageReader ir(_map.path);
 		if (!ir.canRead()) {
@@ -215,92 +224,115 @@ void OziMap::load()
 
 void OziMap::unload()
 {
+	_loader.wait();
+	if (_pool)
+		_pool->clear();
+
 	delete _img;
 	_img = 0;
 }
 
-void OziMap::drawTiled(QPainter *painter, const QRectF &rect) const
+QPixmap OziMap::ozfTile(const FileTile &tile, QFile *file)
+{
+	const OZF *ozf = static_cast<const OZF*>(tile.context());
+	return ozf->tile(*file, tile.zoom(), tile.xy().x(), tile.xy().y());
+}
+
+QPixmap OziMap::fileTile(const FileTile &tile, QFile *file)
+{
+	Q_UNUSED(file);
+	const QString *path = static_cast<const QString*>(tile.context());
+	return QPixmap(path->arg(QString::number(tile.xy().x()),
+	  QString::number(tile.xy().y())));
+}
+
+QPixmap OziMap::tarTile(const FileTile &tile, QFile *file)
+{
+	const OziMap *map = static_cast<const OziMap*>(tile.context());
+	QString name(map->_tile.path.arg(QString::number(tile.xy().x()),
+	  QString::number(tile.xy().y())));
+	return QPixmap::fromImage(QImage::fromData(map->_tar->file(*file, name)));
+}
+
+void OziMap::drawTiled(QPainter *painter, const QRectF &rect, Flags flags)
 {
 	QSizeF ts(_tile.size.width() / _mapRatio, _tile.size.height() / _mapRatio);
 	QPointF tl(floor(rect.left() / ts.width()) * ts.width(),
 	  floor(rect.top() / ts.height()) * ts.height());
+	QList<FileTile> tiles;
 
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
 	for (int i = 0; i < ceil(s.width() / ts.width()); i++) {
 		for (int j = 0; j < ceil(s.height() / ts.height()); j++) {
 			int x = round(tl.x() * _mapRatio + i * _tile.size.width());
 			int y = round(tl.y() * _mapRatio + j * _tile.size.height());
-
-			QString tileName(_tile.path.arg(QString::number(x),
-			  QString::number(y)));
+			QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
+			TileCache::Key key(0, x, y);
 			QPixmap pixmap;
 
-			if (_tar) {
-				QString key = _tar->fileName() + "/" + tileName;
-				if (!QPixmapCache::find(key, &pixmap)) {
-					QByteArray ba = _tar->file(tileName);
-					pixmap = QPixmap::fromImage(QImage::fromData(ba));
-					if (!pixmap.isNull())
-						QPixmapCache::insert(key, pixmap);
-				}
-			} else
-				pixmap = QPixmap(tileName);
-
-			if (pixmap.isNull())
-				qWarning("%s: error loading tile image", qPrintable(
-				  _tile.path.arg(QString::number(x), QString::number(y))));
-			else {
+			if (!(flags & Map::Block) && _loader.isRunning(key))
+				continue;
+
+			if (_cache.find(key, &pixmap)) {
 				pixmap.setDevicePixelRatio(_mapRatio);
-				QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
 				painter->drawPixmap(tp, pixmap);
+			} else if (_tar) {
+				FileTile tile(key, tp, _mapRatio, tarTile, this, _pool);
+				tile.setXY(0, QPoint(x, y));
+				tiles.append(tile);
+			} else {
+				FileTile tile(key, tp, _mapRatio, fileTile, &_tile.path);
+				tile.setXY(0, QPoint(x, y));
+				tiles.append(tile);
 			}
 		}
 	}
+
+	_loader.load(tiles, painter, flags);
 }
 
-void OziMap::drawOZF(QPainter *painter, const QRectF &rect) const
+void OziMap::drawOZF(QPainter *painter, const QRectF &rect, Flags flags)
 {
 	QSizeF ts(_ozf->tileSize().width() / _mapRatio, _ozf->tileSize().height()
 	  / _mapRatio);
 	QPointF tl(floor(rect.left() / ts.width()) * ts.width(),
 	  floor(rect.top() / ts.height()) * ts.height());
+	QList<FileTile> tiles;
 
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
 	for (int i = 0; i < ceil(s.width() / ts.width()); i++) {
 		for (int j = 0; j < ceil(s.height() / ts.height()); j++) {
 			int x = round(tl.x() * _mapRatio + i * _ozf->tileSize().width());
 			int y = round(tl.y() * _mapRatio + j * _ozf->tileSize().height());
-
+			QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
+			TileCache::Key key(_zoom, x, y);
 			QPixmap pixmap;
-			QString key = _ozf->fileName() + "/" + QString::number(_zoom) + "_"
-			  + QString::number(x) + "_" + QString::number(y);
-			if (!QPixmapCache::find(key, &pixmap)) {
-				pixmap = _ozf->tile(_zoom, x, y);
-				if (!pixmap.isNull())
-					QPixmapCache::insert(key, pixmap);
-			}
 
-			if (pixmap.isNull())
-				qWarning("%s: error loading tile image", qPrintable(key));
-			else {
+			if (!(flags & Map::Block) && _loader.isRunning(key))
+				continue;
+
+			if (_cache.find(key, &pixmap)) {
 				pixmap.setDevicePixelRatio(_mapRatio);
-				QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
 				painter->drawPixmap(tp, pixmap);
+			} else {
+				FileTile tile(key, tp, _mapRatio, ozfTile, _ozf, _pool);
+				tile.setXY(_zoom, QPoint(x, y));
+				tiles.append(tile);
 			}
 		}
 	}
+
+	_loader.load(tiles, painter, flags);
 }
 
 void OziMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
-
 	if (_ozf)
-		drawOZF(painter, rect);
+		drawOZF(painter, rect, flags);
 	else if (_img)
 		_img->draw(painter, rect, flags);
 	else if (_tile.isValid())
-		drawTiled(painter, rect);
+		drawTiled(painter, rect, flags);
 }
 
 QPointF OziMap::ll2xy(const Coordinates &c)
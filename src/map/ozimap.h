@@ -3,6 +3,8 @@
 
 #include "transform.h"
 #include "projection.h"
+#include "tilecache.h"
+#include "filetile.h"
 #include "map.h"
 
 class Tar;
@@ -58,12 +60,16 @@ private:
 	bool setTileInfo(const QStringList &tiles, const QString &path = QString());
 	bool setImageInfo(const QString &path);
 
-	void drawTiled(QPainter *painter, const QRectF &rect) const;
-	void drawOZF(QPainter *painter, const QRectF &rect) const;
+	void drawTiled(QPainter *painter, const QRectF &rect, Flags flags);
+	void drawOZF(QPainter *painter, const QRectF &rect, Flags flags);
 	void drawImage(QPainter *painter, const QRectF &rect, Flags flags) const;
 
 	void rescale(int zoom);
 
+	static QPixmap ozfTile(const FileTile &tile, QFile *file);
+	static QPixmap fileTile(const FileTile &tile, QFile *file);
+	static QPixmap tarTile(const FileTile &tile, QFile *file);
+
 	QString _name;
 	Projection _projection;
 	Transform _transform;
@@ -74,6 +80,9 @@ private:
 	int _zoom;
 	QPointF _scale;
 	qreal _mapRatio;
+	TileCache::Partition _cache;
+	FilePool *_pool;
+	FileTileLoader _loader;
 
 	bool _valid;
 	QString _errorString;
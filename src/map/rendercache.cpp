@@ -0,0 +1,218 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QDirIterator>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QHash>
+#include <QPixmap>
+#include <algorithm>
+#include "common/programpaths.h"
+#include "projection.h"
+#include "rendercache.h"
+
+
+#define CACHE_DIR "render"
+/* Evict down to this fraction of the cache size to not run the eviction on
+   every stored tile once the cache is full */
+#define EVICT_RATIO 0.9
+
+/* The index is built on the first stored tile, i.e. in a render thread, as
+   scanning the cache directory may take some time. The cache size limit is
+   applied from then on. */
+class CacheIndex
+{
+public:
+	CacheIndex() : _enabled(0), _maxSize(0), _size(0), _loaded(false) {}
+
+	/* Called from draw() in the GUI thread, must not wait for the index */
+	bool isEnabled() const {return (_enabled.loadAcquire() != 0);}
+
+	void setMaxSize(qint64 size)
+	{
+		_enabled.storeRelease(size > 0);
+
+		QMutexLocker locker(&_lock);
+
+		_maxSize = size;
+		if (_loaded && _maxSize && _size > _maxSize)
+			evict();
+	}
+
+	void touch(const QString &file)
+	{
+		QMutexLocker locker(&_lock);
+
+		QHash<QString, Entry>::iterator it = _entries.find(file);
+		if (it != _entries.end())
+			it->time = QDateTime::currentMSecsSinceEpoch();
+	}
+
+	void add(const QString &file, qint64 size)
+	{
+		QMutexLocker locker(&_lock);
+
+		if (!_loaded)
+			load();
+
+		QHash<QString, Entry>::iterator it = _entries.find(file);
+		if (it != _entries.end())
+			_size -= it->size;
+		_entries.insert(file, Entry(size, QDateTime::currentMSecsSinceEpoch()));
+		_size += size;
+
+		if (_maxSize && _size > _maxSize)
+			evict();
+	}
+
+private:
+	struct Entry {
+		Entry() : size(0), time(0) {}
+		Entry(qint64 size, qint64 time) : size(size), time(time) {}
+
+		qint64 size;
+		qint64 time;
+	};
+
+	typedef QPair<qint64, QString> Item;
+
+	void load()
+	{
+		QDirIterator it(QDir(ProgramPaths::tilesDir()).filePath(CACHE_DIR),
+		  QDir::Files, QDirIterator::Subdirectories);
+
+		while (it.hasNext()) {
+			it.next();
+			QFileInfo fi(it.fileInfo());
+			_entries.insert(fi.filePath(), Entry(fi.size(),
+			  fi.lastModified().toMSecsSinceEpoch()));
+			_size += fi.size();
+		}
+
+		_loaded = true;
+	}
+
+	void evict()
+	{
+		QVector<Item> items;
+		qint64 limit = _maxSize * EVICT_RATIO;
+
+		items.reserve(_entries.size());
+		for (QHash<QString, Entry>::const_iterator it = _entries.constBegin();
+		  it != _entries.constEnd(); ++it)
+			items.append(Item(it->time, it.key()));
+		std::sort(items.begin(), items.end());
+
+		for (int i = 0; i < items.size() && _size > limit; i++) {
+			const QString &file = items.at(i).second;
+			QFile::remove(file);
+			_size -= _entries.take(file).size;
+		}
+	}
+
+	QAtomicInt _enabled;
+	QMutex _lock;
+	QHash<QString, Entry> _entries;
+	qint64 _maxSize, _size;
+	bool _loaded;
+};
+
+static CacheIndex &cacheIndex()
+{
+	static CacheIndex idx;
+	return idx;
+}
+
+static void fileId(const QString &fileName, QCryptographicHash &hash)
+{
+	QFileInfo fi(fileName);
+
+	hash.addData(fi.absoluteFilePath().toUtf8());
+	hash.addData(QByteArray::number(fi.size()));
+	hash.addData(QByteArray::number(fi.lastModified().toMSecsSinceEpoch()));
+}
+
+RenderCache::RenderCache(const QString &fileName, const QString &styleFile)
+{
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+
+	/* The rendering itself may change between versions */
+	hash.addData(QByteArray(APP_VERSION));
+	fileId(fileName, hash);
+	if (!styleFile.isEmpty())
+		fileId(styleFile, hash);
+
+	_id = hash.result();
+}
+
+QString RenderCache::path(int zoom, const Projection &proj, qreal ratio) const
+{
+	if (_id.isEmpty() || !cacheIndex().isEnabled())
+		return QString();
+
+	/* Projections have no persistent identifier, so a projection is
+	   identified by the projected coordinates of some sample points */
+	static const Coordinates samples[] = {Coordinates(0, 0),
+	  Coordinates(15, 45), Coordinates(-120, -30), Coordinates(150, 70)};
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+
+	hash.addData(_id);
+	hash.addData(QByteArray::number(zoom));
+	hash.addData(QByteArray::number(ratio));
+	for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+		PointD p(proj.ll2xy(samples[i]));
+		hash.addData(QByteArray::number(p.x(), 'g', 10));
+		hash.addData(QByteArray::number(p.y(), 'g', 10));
+	}
+
+	return QDir(ProgramPaths::tilesDir()).filePath(QString(CACHE_DIR) + "/"
+	  + QString::fromLatin1(hash.result().toHex()));
+}
+
+QString RenderCache::tileFile(const QString &path, const QPoint &xy)
+{
+	if (path.isNull())
+		return QString();
+
+	return path + "/" + QString::number(xy.x()) + "_" + QString::number(xy.y())
+	  + ".png";
+}
+
+bool RenderCache::load(const QString &tileFile, qreal ratio, QPixmap &pixmap)
+{
+	if (tileFile.isNull())
+		return false;
+	if (!pixmap.load(tileFile, "PNG"))
+		return false;
+
+	pixmap.setDevicePixelRatio(ratio);
+	cacheIndex().touch(tileFile);
+
+	return true;
+}
+
+void RenderCache::save(const QString &tileFile, const QPixmap &pixmap)
+{
+	if (tileFile.isNull() || pixmap.isNull())
+		return;
+
+	QFileInfo fi(tileFile);
+	if (!QDir().mkpath(fi.path()))
+		return;
+
+	/* Save atomically, other threads may be loading the same tile */
+	QSaveFile file(tileFile);
+	if (!file.open(QIODevice::WriteOnly))
+		return;
+	if (!pixmap.save(&file, "PNG") || !file.commit())
+		return;
+
+	cacheIndex().add(tileFile, QFileInfo(tileFile).size());
+}
+
+void RenderCache::setSize(int size)
+{
+	cacheIndex().setMaxSize((qint64)size * 1024 * 1024);
+}
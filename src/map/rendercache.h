@@ -0,0 +1,35 @@
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+#include <QString>
+#include <QByteArray>
+
+class QPixmap;
+class QPoint;
+class Projection;
+
+/* Persistent disk cache of rendered (vector) map tiles. The tiles are
+   identified by the map file (path, size and modification time), the style
+   file, the zoom, the output projection and the device pixel ratio. The cache
+   size is bounded, least recently used tiles are removed first. */
+class RenderCache
+{
+public:
+	RenderCache() {}
+	RenderCache(const QString &fileName, const QString &styleFile = QString());
+
+	/* Directory of the tile set or a null string if the cache is disabled */
+	QString path(int zoom, const Projection &proj, qreal ratio) const;
+
+	static QString tileFile(const QString &path, const QPoint &xy);
+	static bool load(const QString &tileFile, qreal ratio, QPixmap &pixmap);
+	static void save(const QString &tileFile, const QPixmap &pixmap);
+
+	/* Cache size in MB, 0 disables the cache */
+	static void setSize(int size);
+
+private:
+	QByteArray _id;
+};
+
+#endif // RENDERCACHE_H
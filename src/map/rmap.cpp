@@ -1,6 +1,5 @@
 #include <QFileInfo>
 #include <QDataStream>
-#include <QPixmapCache>
 #include <QPainter>
 #include <QRegularExpression>
 #include <QtEndian>
@@ -264,9 +263,11 @@ bool RMap::readHeader(QDataStream &stream, Header &hdr)
 }
 
 RMap::RMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _file(fileName), _mapRatio(1.0), _zoom(0),
-  _valid(false)
+  : Map(fileName, parent), _file(fileName), _mapRatio(1.0), _cache(fileName),
+  _pool(fileName), _loader(&_cache), _zoom(0), _valid(false)
 {
+	connect(&_loader, &FileTileLoader::loaded, this, &Map::tilesLoaded);
+
 	if (!_file.open(QIODevice::ReadOnly)) {
 		_errorString = _file.errorString();
 		return;
@@ -353,29 +354,31 @@ Coordinates RMap::xy2ll(const QPointF &p)
 	  p.y() / scale.y()) * _mapRatio));
 }
 
-void RMap::load()
+RMap::~RMap()
 {
-	_file.open(QIODevice::ReadOnly);
+	_loader.wait();
 }
 
 void RMap::unload()
 {
-	_file.close();
+	_loader.wait();
+	_pool.clear();
 }
 
-QPixmap RMap::tile(int x, int y)
+QPixmap RMap::tile(const FileTile &tile, QFile *file)
 {
-	const Zoom &zoom = _zooms.at(_zoom);
+	const RMap *map = static_cast<const RMap*>(tile.context());
+	const Zoom &zoom = map->_zooms.at(tile.zoom());
 
-	qint32 index = y / _tileSize.height() * zoom.dim.width()
-	  + x / _tileSize.width();
-	if (index > zoom.tiles.size())
+	qint32 index = tile.xy().y() / map->_tileSize.height() * zoom.dim.width()
+	  + tile.xy().x() / map->_tileSize.width();
+	if (index < 0 || index >= zoom.tiles.size())
 		return QPixmap();
 
 	quint64 offset = zoom.tiles.at(index);
-	if (!_file.seek(offset))
+	if (!file->seek(offset))
 		return QPixmap();
-	QDataStream stream(&_file);
+	QDataStream stream(file);
 	stream.setByteOrder(QDataStream::LittleEndian);
 	quint32 tag;
 	stream >> tag;
@@ -383,7 +386,7 @@ QPixmap RMap::tile(int x, int y)
 		return QPixmap();
 
 	if (tag == 2) {
-		if (_palette.isEmpty())
+		if (map->_palette.isEmpty())
 			return QPixmap();
 		quint32 width, height, size;
 		stream >> width >> height >> size;
@@ -401,7 +404,7 @@ QPixmap RMap::tile(int x, int y)
 			return QPixmap();
 		QImage img((const uchar*)uba.constData(), tileSize.width(),
 		  tileSize.height(), QImage::Format_Indexed8);
-		img.setColorTable(_palette);
+		img.setColorTable(map->_palette);
 
 		return QPixmap::fromImage(img);
 	} else if (tag == 7) {
@@ -421,36 +424,35 @@ QPixmap RMap::tile(int x, int y)
 
 void RMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 {
-	Q_UNUSED(flags);
-
 	QSizeF ts(_tileSize.width() / _mapRatio, _tileSize.height() / _mapRatio);
 	QPointF tl(floor(rect.left() / ts.width()) * ts.width(),
 	  floor(rect.top() / ts.height()) * ts.height());
+	QList<FileTile> tiles;
 
 	QSizeF s(rect.right() - tl.x(), rect.bottom() - tl.y());
 	for (int i = 0; i < ceil(s.width() / ts.width()); i++) {
 		for (int j = 0; j < ceil(s.height() / ts.height()); j++) {
 			int x = round(tl.x() * _mapRatio + i * _tileSize.width());
 			int y = round(tl.y() * _mapRatio + j * _tileSize.height());
-
+			QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
+			TileCache::Key key(_zoom, x, y);
 			QPixmap pixmap;
-			QString key = path() + "/" + QString::number(_zoom) + "_"
-			  + QString::number(x) + "_" + QString::number(y);
-			if (!QPixmapCache::find(key, &pixmap)) {
-				pixmap = tile(x, y);
-				if (!pixmap.isNull())
-					QPixmapCache::insert(key, pixmap);
-			}
 
-			if (pixmap.isNull())
-				qWarning("%s: error loading tile image", qPrintable(key));
-			else {
+			if (!(flags & Map::Block) && _loader.isRunning(key))
+				continue;
+
+			if (_cache.find(key, &pixmap)) {
 				pixmap.setDevicePixelRatio(_mapRatio);
-				QPointF tp(tl.x() + i * ts.width(), tl.y() + j * ts.height());
 				painter->drawPixmap(tp, pixmap);
+			} else {
+				FileTile tile(key, tp, _mapRatio, RMap::tile, this, &_pool);
+				tile.setXY(_zoom, QPoint(x, y));
+				tiles.append(tile);
 			}
 		}
 	}
+
+	_loader.load(tiles, painter, flags);
 }
 
 void RMap::setDevicePixelRatio(qreal deviceRatio, qreal mapRatio)
@@ -6,6 +6,8 @@
 #include "map.h"
 #include "transform.h"
 #include "projection.h"
+#include "tilecache.h"
+#include "filetile.h"
 
 class RMap : public Map
 {
@@ -13,6 +15,7 @@ class RMap : public Map
 
 public:
 	RMap(const QString &fileName, QObject *parent = 0);
+	~RMap();
 
 	QRectF bounds();
 
@@ -26,7 +29,6 @@ public:
 	Coordinates xy2ll(const QPointF &p);
 
 	void setDevicePixelRatio(qreal deviceRatio, qreal mapRatio);
-	void load();
 	void unload();
 
 	void draw(QPainter *painter, const QRectF &rect, Flags flags);
@@ -60,7 +62,7 @@ private:
 	bool readZoomLevel(quint64 offset, const QSize &imageSize);
 	QByteArray readIMP(quint64 IMPOffset);
 	bool parseIMP(const QByteArray &data);
-	QPixmap tile(int x, int y);
+	static QPixmap tile(const FileTile &tile, QFile *file);
 
 	QList<Zoom> _zooms;
 	Projection _projection;
@@ -68,6 +70,9 @@ private:
 	QSize _tileSize;
 	QFile _file;
 	qreal _mapRatio;
+	TileCache::Partition _cache;
+	FilePool _pool;
+	FileTileLoader _loader;
 	int _zoom;
 	QVector<QRgb> _palette;
 
@@ -2,7 +2,6 @@
 #include <QSqlRecord>
 #include <QSqlField>
 #include <QPainter>
-#include <QPixmapCache>
 #include <QImageReader>
 #include <QBuffer>
 #include <QtConcurrent>
@@ -15,11 +14,11 @@
 class SqliteTile
 {
 public:
-	SqliteTile(const QPoint &xy, const QByteArray &data, const QString &key)
+	SqliteTile(const QPoint &xy, const QByteArray &data, const TileCache::Key &key)
 	  : _xy(xy), _data(data), _key(key) {}
 
 	const QPoint &xy() const {return _xy;}
-	const QString &key() const {return _key;}
+	const TileCache::Key &key() const {return _key;}
 	const QPixmap &pixmap() const {return _pixmap;}
 
 	void load() {_pixmap.loadFromData(_data);}
@@ -27,13 +26,13 @@ public:
 private:
 	QPoint _xy;
 	QByteArray _data;
-	QString _key;
+	TileCache::Key _key;
 	QPixmap _pixmap;
 };
 
 
 SqliteMap::SqliteMap(const QString &fileName, QObject *parent)
-  : Map(fileName, parent), _mapRatio(1.0), _valid(false)
+  : Map(fileName, parent), _mapRatio(1.0), _cache(fileName), _valid(false)
 {
 	_db = QSqlDatabase::addDatabase("QSQLITE", fileName);
 	_db.setDatabaseName(fileName);
@@ -221,10 +220,9 @@ void SqliteMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		for (int j = 0; j < height; j++) {
 			QPixmap pm;
 			QPoint t(tile.x() + i, tile.y() + j);
-			QString key = path() + "-" + QString::number(_zoom) + "_"
-			  + QString::number(t.x()) + "_" + QString::number(t.y());
+			TileCache::Key key(_zoom, t.x(), t.y());
 
-			if (QPixmapCache::find(key, &pm)) {
+			if (_cache.find(key, &pm)) {
 				QPointF tp(qMax(tl.x(), b.left()) + (t.x() - tile.x())
 				  * tileSize(), qMax(tl.y(), b.top()) + (t.y() - tile.y())
 				  * tileSize());
@@ -244,7 +242,7 @@ void SqliteMap::draw(QPainter *painter, const QRectF &rect, Flags flags)
 		if (pm.isNull())
 			continue;
 
-		QPixmapCache::insert(mt.key(), pm);
+		_cache.insert(mt.key(), pm);
 
 		QPointF tp(qMax(tl.x(), b.left()) + (mt.xy().x() - tile.x())
 		  * tileSize(), qMax(tl.y(), b.top()) + (mt.xy().y() - tile.y())
@@ -3,6 +3,7 @@
 
 #include <QSqlDatabase>
 #include "common/range.h"
+#include "tilecache.h"
 #include "map.h"
 
 class SqliteMap : public Map
@@ -45,6 +46,7 @@ private:
 	int _zoom;
 	int _tileSize;
 	qreal _mapRatio;
+	TileCache::Partition _cache;
 
 	bool _valid;
 	QString _errorString;
@@ -111,6 +111,14 @@ bool Tar::loadTmi(const QString &path)
 }
 
 QByteArray Tar::file(const QString &name)
+{
+	Q_ASSERT(_file.isOpen());
+	return file(_file, name);
+}
+
+/* Reads the file using the given handle of the tar file, so that the files
+   can be read by several threads at once, each one using its own handle. */
+QByteArray Tar::file(QFile &file, const QString &name) const
 {
 	char buffer[BLOCKSIZE];
 	TARHeader *hdr = (TARHeader*)&buffer;
@@ -120,12 +128,11 @@ QByteArray Tar::file(const QString &name)
 	if (it == _index.constEnd())
 		return QByteArray();
 
-	Q_ASSERT(_file.isOpen());
-	if (_file.seek(it.value() * BLOCKSIZE)) {
-		if (_file.read(buffer, BLOCKSIZE) < BLOCKSIZE)
+	if (file.seek(it.value() * BLOCKSIZE)) {
+		if (file.read(buffer, BLOCKSIZE) < BLOCKSIZE)
 			return QByteArray();
 		size = number(hdr->size, sizeof(hdr->size));
-		return _file.read(size);
+		return file.read(size);
 	} else
 		return QByteArray();
 }
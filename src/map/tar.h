@@ -14,6 +14,7 @@ public:
 
 	QStringList files() const {return _index.keys();}
 	QByteArray file(const QString &name);
+	QByteArray file(QFile &file, const QString &name) const;
 	bool contains(const QString &name) const {return _index.contains(name);}
 
 	QString fileName() const {return _file.fileName();}
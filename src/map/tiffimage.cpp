@@ -0,0 +1,647 @@
+#include <cstring>
+#include <QtEndian>
+#include <QPainter>
+#include "common/tifffile.h"
+#include "tiffimage.h"
+
+
+#define NewSubfileTypeTag            254
+#define ImageWidthTag                256
+#define ImageLengthTag               257
+#define BitsPerSampleTag             258
+#define CompressionTag               259
+#define PhotometricInterpretationTag 262
+#define StripOffsetsTag              273
+#define SamplesPerPixelTag           277
+#define RowsPerStripTag              278
+#define StripByteCountsTag           279
+#define PlanarConfigurationTag       284
+#define PredictorTag                 317
+#define ColorMapTag                  320
+#define TileWidthTag                 322
+#define TileLengthTag                323
+#define TileOffsetsTag               324
+#define TileByteCountsTag            325
+#define ExtraSamplesTag              338
+#define SampleFormatTag              339
+#define JPEGTablesTag                347
+
+#define COMPRESSION_NONE             1
+#define COMPRESSION_LZW              5
+#define COMPRESSION_JPEG             7
+#define COMPRESSION_DEFLATE          8
+#define COMPRESSION_PACKBITS         32773
+#define COMPRESSION_ADOBE_DEFLATE    32946
+
+#define PHOTOMETRIC_WHITEISZERO      0
+#define PHOTOMETRIC_BLACKISZERO      1
+#define PHOTOMETRIC_RGB              2
+#define PHOTOMETRIC_PALETTE          3
+#define PHOTOMETRIC_YCBCR            6
+
+#define FILETYPE_REDUCEDIMAGE        0x1
+#define FILETYPE_MASK                0x4
+
+#define TIFF_UNDEFINED               7
+
+#define MAX_IFDS       32
+#define MAX_BLOCK_SIZE (32 * 1024 * 1024)
+#define TILE_SIZE      512
+
+#define MIN_STRIP_CACHE 16384  /* kB */
+#define MAX_STRIP_CACHE 131072 /* kB */
+
+static QByteArray lzw(const QByteArray &data, int size)
+{
+	quint16 prefix[4096];
+	quint8 suffix[4096], first[4096];
+	int length[4096];
+	QByteArray out;
+	quint32 buffer = 0;
+	int bits = 9, cnt = 0, next = 258, prev = -1, pos = 0;
+
+	for (int i = 0; i < 256; i++) {
+		prefix[i] = 0;
+		suffix[i] = first[i] = i;
+		length[i] = 1;
+	}
+	out.reserve(size);
+
+	while (out.size() < size) {
+		while (cnt < bits) {
+			if (pos >= data.size())
+				return out;
+			buffer = (buffer << 8) | (quint8)data.at(pos++);
+			cnt += 8;
+		}
+		int code = (buffer >> (cnt - bits)) & ((1 << bits) - 1);
+		cnt -= bits;
+
+		if (code == 257)
+			break;
+		if (code == 256) {
+			bits = 9;
+			next = 258;
+			prev = -1;
+			continue;
+		}
+
+		if (prev < 0) {
+			if (code > 255)
+				return out;
+			out.append((char)code);
+			prev = code;
+			continue;
+		}
+
+		if (code > next || next >= 4096)
+			return out;
+		prefix[next] = prev;
+		suffix[next] = (code == next) ? first[prev] : first[code];
+		first[next] = first[prev];
+		length[next] = length[prev] + 1;
+		next++;
+
+		int offset = out.size();
+		out.resize(offset + length[code]);
+		char *dst = out.data() + offset;
+		for (int c = code, i = length[code] - 1; i >= 0; c = prefix[c], i--)
+			dst[i] = suffix[c];
+
+		prev = code;
+		if (next == (1 << bits) - 1 && bits < 12)
+			bits++;
+	}
+
+	return out;
+}
+
+static QByteArray packBits(const QByteArray &data, int size)
+{
+	QByteArray out;
+	int pos = 0;
+
+	out.reserve(size);
+
+	while (pos < data.size() && out.size() < size) {
+		int n = (qint8)data.at(pos++);
+
+		if (n >= 0) {
+			if (pos + n + 1 > data.size())
+				break;
+			out.append(data.constData() + pos, n + 1);
+			pos += n + 1;
+		} else if (n != -128) {
+			if (pos >= data.size())
+				break;
+			out.append(1 - n, data.at(pos++));
+		}
+	}
+
+	return out;
+}
+
+static QByteArray inflate(const QByteArray &data, int size)
+{
+	quint32 bes = qToBigEndian((quint32)size);
+	QByteArray ba;
+
+	ba.resize(sizeof(bes) + data.size());
+	memcpy(ba.data(), &bes, sizeof(bes));
+	memcpy(ba.data() + sizeof(bes), data.constData(), data.size());
+
+	return qUncompress(ba);
+}
+
+bool TIFFImage::readValues(TIFFFile &file, quint32 entry, quint16 type,
+  quint32 count, QVector<quint32> &values)
+{
+	quint32 size, offset;
+
+	switch (type) {
+		case TIFF_BYTE:
+			size = 1;
+			break;
+		case TIFF_SHORT:
+			size = 2;
+			break;
+		case TIFF_LONG:
+			size = 4;
+			break;
+		default:
+			return false;
+	}
+	if (count > (MAX_BLOCK_SIZE / size))
+		return false;
+
+	if (!file.seek(entry + 8))
+		return false;
+	if (count * size > 4) {
+		if (!file.readValue(offset))
+			return false;
+		if (!file.seek(offset))
+			return false;
+	}
+
+	values.resize(count);
+	for (quint32 i = 0; i < count; i++) {
+		if (type == TIFF_BYTE) {
+			quint8 val;
+			if (!file.readValue(val))
+				return false;
+			values[i] = val;
+		} else if (type == TIFF_SHORT) {
+			quint16 val;
+			if (!file.readValue(val))
+				return false;
+			values[i] = val;
+		} else {
+			if (!file.readValue(values[i]))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+bool TIFFImage::readEntry(TIFFFile &file, quint32 entry, Zoom &zoom)
+{
+	quint16 tag;
+	quint16 type;
+	quint32 count, offset;
+	QVector<quint32> v;
+
+	if (!file.seek(entry))
+		return false;
+	if (!file.readValue(tag))
+		return false;
+	if (!file.readValue(type))
+		return false;
+	if (!file.readValue(count))
+		return false;
+
+	switch (tag) {
+		case JPEGTablesTag:
+			if (type != TIFF_UNDEFINED && type != TIFF_BYTE)
+				return false;
+			if (count > 4) {
+				if (!file.readValue(offset))
+					return false;
+				if (!file.seek(offset))
+					return false;
+			}
+			zoom.jpegTables = file.read(count);
+			return (zoom.jpegTables.size() == (int)count);
+		case NewSubfileTypeTag:
+		case ImageWidthTag:
+		case ImageLengthTag:
+		case BitsPerSampleTag:
+		case CompressionTag:
+		case PhotometricInterpretationTag:
+		case StripOffsetsTag:
+		case SamplesPerPixelTag:
+		case RowsPerStripTag:
+		case StripByteCountsTag:
+		case PlanarConfigurationTag:
+		case PredictorTag:
+		case ColorMapTag:
+		case TileWidthTag:
+		case TileLengthTag:
+		case TileOffsetsTag:
+		case TileByteCountsTag:
+		case ExtraSamplesTag:
+		case SampleFormatTag:
+			if (!readValues(file, entry, type, count, v) || v.isEmpty())
+				return false;
+			break;
+		default:
+			return true;
+	}
+
+	switch (tag) {
+		case NewSubfileTypeTag:
+			zoom.subfileType = v.first();
+			break;
+		case ImageWidthTag:
+			zoom.size.setWidth(v.first());
+			break;
+		case ImageLengthTag:
+			zoom.size.setHeight(v.first());
+			break;
+		case BitsPerSampleTag:
+			zoom.bitsPerSample = v.first();
+			for (int i = 1; i < v.size(); i++)
+				if (v.at(i) != v.first())
+					zoom.bitsPerSample = 0;
+			break;
+		case CompressionTag:
+			zoom.compression = v.first();
+			break;
+		case PhotometricInterpretationTag:
+			zoom.photometric = v.first();
+			break;
+		case SamplesPerPixelTag:
+			zoom.samplesPerPixel = v.first();
+			break;
+		case RowsPerStripTag:
+			zoom.rowsPerStrip = v.first();
+			break;
+		case PlanarConfigurationTag:
+			zoom.planarConfig = v.first();
+			break;
+		case PredictorTag:
+			zoom.predictor = v.first();
+			break;
+		case ExtraSamplesTag:
+			zoom.extraSamples = v.first();
+			break;
+		case SampleFormatTag:
+			zoom.sampleFormat = v.first();
+			for (int i = 1; i < v.size(); i++)
+				if (v.at(i) != v.first())
+					zoom.sampleFormat = 0;
+			break;
+		case TileWidthTag:
+			zoom.tileSize.setWidth(v.first());
+			break;
+		case TileLengthTag:
+			zoom.tileSize.setHeight(v.first());
+			break;
+		case StripOffsetsTag:
+		case TileOffsetsTag:
+			zoom.offsets = v;
+			break;
+		case StripByteCountsTag:
+		case TileByteCountsTag:
+			zoom.sizes = v;
+			break;
+		case ColorMapTag:
+			zoom.palette.resize(v.size() / 3);
+			for (int i = 0, n = zoom.palette.size(); i < n; i++)
+				zoom.palette[i] = qRgb(v.at(i) >> 8, v.at(n + i) >> 8,
+				  v.at(2 * n + i) >> 8);
+			break;
+	}
+
+	return true;
+}
+
+bool TIFFImage::readIFD(TIFFFile &file, quint32 &offset, Zoom &zoom)
+{
+	quint16 count;
+
+	if (!file.seek(offset))
+		return false;
+	if (!file.readValue(count))
+		return false;
+
+	for (quint16 i = 0; i < count; i++)
+		if (!readEntry(file, offset + 2 + i * 12, zoom))
+			return false;
+
+	if (!file.seek(offset + 2 + count * 12))
+		return false;
+	if (!file.readValue(offset))
+		return false;
+
+	if (!zoom.tileSize.isValid()) {
+		zoom.tileSize = QSize();
+		if (!zoom.rowsPerStrip
+		  || zoom.rowsPerStrip > (quint32)zoom.size.height())
+			zoom.rowsPerStrip = zoom.size.height();
+	}
+
+	if (zoom.palette.isEmpty() && zoom.samplesPerPixel == 1
+	  && (zoom.photometric == PHOTOMETRIC_WHITEISZERO
+	  || zoom.photometric == PHOTOMETRIC_BLACKISZERO)) {
+		zoom.palette.resize(256);
+		for (int i = 0; i < 256; i++) {
+			int c = (zoom.photometric == PHOTOMETRIC_WHITEISZERO)
+			  ? 255 - i : i;
+			zoom.palette[i] = qRgb(c, c, c);
+		}
+	}
+
+	return true;
+}
+
+bool TIFFImage::isSupported(const Zoom &zoom) const
+{
+	if (zoom.size.isEmpty())
+		return false;
+	if (zoom.bitsPerSample != 8 || zoom.sampleFormat != 1)
+		return false;
+	if (zoom.planarConfig != 1 && zoom.samplesPerPixel != 1)
+		return false;
+	if (zoom.predictor != 1 && zoom.predictor != 2)
+		return false;
+
+	switch (zoom.compression) {
+		case COMPRESSION_NONE:
+		case COMPRESSION_LZW:
+		case COMPRESSION_DEFLATE:
+		case COMPRESSION_ADOBE_DEFLATE:
+		case COMPRESSION_PACKBITS:
+		case COMPRESSION_JPEG:
+			break;
+		default:
+			return false;
+	}
+
+	switch (zoom.photometric) {
+		case PHOTOMETRIC_WHITEISZERO:
+		case PHOTOMETRIC_BLACKISZERO:
+			if (zoom.samplesPerPixel != 1)
+				return false;
+			break;
+		case PHOTOMETRIC_PALETTE:
+			if (zoom.samplesPerPixel != 1 || zoom.palette.size() != 256)
+				return false;
+			break;
+		case PHOTOMETRIC_RGB:
+			if (zoom.samplesPerPixel != 3 && zoom.samplesPerPixel != 4)
+				return false;
+			break;
+		case PHOTOMETRIC_YCBCR:
+			if (zoom.compression != COMPRESSION_JPEG
+			  || zoom.samplesPerPixel != 3)
+				return false;
+			break;
+		default:
+			return false;
+	}
+
+	QSize bs(blockSize(zoom));
+	if (bs.isEmpty()
+	  || (qint64)bs.width() * bs.height() * zoom.samplesPerPixel
+	  > MAX_BLOCK_SIZE)
+		return false;
+
+	int blocks = ((zoom.size.width() - 1) / bs.width() + 1)
+	  * ((zoom.size.height() - 1) / bs.height() + 1);
+	if (zoom.offsets.size() != blocks || zoom.sizes.size() != blocks)
+		return false;
+
+	return true;
+}
+
+/* The IFDs are read only on the first open(), when the image is reopened
+   after close() only the file is opened. */
+bool TIFFImage::open()
+{
+	if (!_file.open(QIODevice::ReadOnly))
+		return false;
+	if (!_zooms.isEmpty())
+		return true;
+
+	TIFFFile tiff(&_file);
+	if (!tiff.isValid()) {
+		_file.close();
+		return false;
+	}
+
+	quint32 ifd = tiff.ifd();
+	for (int i = 0; ifd && i < MAX_IFDS; i++) {
+		Zoom zoom;
+
+		if (!readIFD(tiff, ifd, zoom))
+			break;
+
+		if (_zooms.isEmpty()) {
+			if (!isSupported(zoom))
+				break;
+			_zooms.append(zoom);
+		} else if ((zoom.subfileType & FILETYPE_REDUCEDIMAGE)
+		  && !(zoom.subfileType & FILETYPE_MASK) && isSupported(zoom)
+		  && zoom.size.width() < _zooms.last().size.width())
+			_zooms.append(zoom);
+	}
+
+	if (_zooms.isEmpty()) {
+		_file.close();
+		return false;
+	}
+
+	/* The strip cache must hold all the strips of a tile row, otherwise the
+	   strips would be decoded again for every tile of the row. */
+	qint64 cost = MIN_STRIP_CACHE;
+	for (int i = 0; i < _zooms.size(); i++) {
+		const Zoom &z = _zooms.at(i);
+		if (!z.tileSize.isValid())
+			cost = qMax(cost, (qint64)z.size.width() * 4 * tileSize(i).height()
+			  / 1024);
+	}
+	_strips.setMaxCost(qMin(cost, (qint64)MAX_STRIP_CACHE));
+
+	return true;
+}
+
+QSize TIFFImage::size(int zoom) const
+{
+	Q_ASSERT(0 <= zoom && zoom < _zooms.count());
+
+	return _zooms.at(zoom).size;
+}
+
+QPointF TIFFImage::scale(int zoom) const
+{
+	return QPointF((qreal)size(zoom).width() / (qreal)size(0).width(),
+	  (qreal)size(zoom).height() / (qreal)size(0).height());
+}
+
+QSize TIFFImage::blockSize(const Zoom &zoom) const
+{
+	return zoom.tileSize.isValid()
+	  ? zoom.tileSize : QSize(zoom.size.width(), zoom.rowsPerStrip);
+}
+
+/* Tiled images use the native tile size, striped images are split into
+   TILE_SIZE wide tiles containing whole strips (see cachedBlock()). */
+QSize TIFFImage::tileSize(int zoom) const
+{
+	Q_ASSERT(0 <= zoom && zoom < _zooms.count());
+
+	const Zoom &z = _zooms.at(zoom);
+	if (z.tileSize.isValid())
+		return z.tileSize;
+
+	int rows = z.rowsPerStrip;
+	return QSize(qMin(z.size.width(), TILE_SIZE),
+	  (rows < TILE_SIZE) ? (TILE_SIZE / rows) * rows : rows);
+}
+
+QImage TIFFImage::block(const Zoom &zoom, int x, int y)
+{
+	QSize bs(blockSize(zoom));
+	int i = y * ((zoom.size.width() - 1) / bs.width() + 1) + x;
+	if (i < 0 || i >= zoom.offsets.size() || i >= zoom.sizes.size())
+		return QImage();
+	if (!zoom.tileSize.isValid())
+		bs.setHeight(qMin(bs.height(), zoom.size.height() - y * bs.height()));
+
+	if (!_file.seek(zoom.offsets.at(i)))
+		return QImage();
+	QByteArray ba(_file.read(zoom.sizes.at(i)));
+	if (ba.size() != (int)zoom.sizes.at(i))
+		return QImage();
+
+	if (zoom.compression == COMPRESSION_JPEG) {
+		if (zoom.jpegTables.size() > 4 && ba.size() > 2)
+			ba = zoom.jpegTables.left(zoom.jpegTables.size() - 2) + ba.mid(2);
+		return QImage::fromData(ba, "JPG");
+	}
+
+	int bpl = bs.width() * zoom.samplesPerPixel;
+	int size = bpl * bs.height();
+	QByteArray data;
+
+	switch (zoom.compression) {
+		case COMPRESSION_LZW:
+			data = lzw(ba, size);
+			break;
+		case COMPRESSION_DEFLATE:
+		case COMPRESSION_ADOBE_DEFLATE:
+			data = inflate(ba, size);
+			break;
+		case COMPRESSION_PACKBITS:
+			data = packBits(ba, size);
+			break;
+		default:
+			data = ba;
+	}
+	if (data.size() < size)
+		return QImage();
+
+	if (zoom.predictor == 2) {
+		for (int r = 0; r < bs.height(); r++) {
+			quint8 *row = (quint8*)data.data() + r * bpl;
+			for (int c = zoom.samplesPerPixel; c < bpl; c++)
+				row[c] += row[c - zoom.samplesPerPixel];
+		}
+	}
+
+	QImage::Format format;
+	switch (zoom.samplesPerPixel) {
+		case 1:
+			format = QImage::Format_Indexed8;
+			break;
+		case 3:
+			format = QImage::Format_RGB888;
+			break;
+		default:
+			format = (zoom.extraSamples == 1)
+			  ? QImage::Format_RGBA8888_Premultiplied
+			  : QImage::Format_RGBA8888;
+	}
+
+	QImage img(bs, format);
+	if (img.isNull())
+		return QImage();
+	for (int r = 0; r < bs.height(); r++)
+		memcpy(img.scanLine(r), data.constData() + r * bpl, bpl);
+	if (format == QImage::Format_Indexed8)
+		img.setColorTable(zoom.palette);
+
+	return img;
+}
+
+/* Striped images are split into tiles narrower than the strips, so every
+   decoded strip is used by all the tiles of the tile row and is cached. */
+QImage TIFFImage::cachedBlock(int zoom, int x, int y)
+{
+	const Zoom &z = _zooms.at(zoom);
+	if (z.tileSize.isValid())
+		return block(z, x, y);
+
+	QPair<int, int> key(zoom, y);
+	QImage *cached = _strips.object(key);
+	if (cached)
+		return *cached;
+
+	QImage img(block(z, x, y));
+	if (!img.isNull())
+		_strips.insert(key, new QImage(img),
+		  qMax(img.bytesPerLine() * img.height() / 1024, 1));
+
+	return img;
+}
+
+QImage TIFFImage::tile(int zoom, int x, int y)
+{
+	Q_ASSERT(_file.isOpen());
+	Q_ASSERT(0 <= zoom && zoom < _zooms.count());
+
+	const Zoom &z = _zooms.at(zoom);
+	QRect tr(QRect(QPoint(x, y), tileSize(zoom))
+	  & QRect(QPoint(0, 0), z.size));
+	if (tr.isEmpty())
+		return QImage();
+
+	QSize bs(blockSize(z));
+	int left = tr.left() / bs.width(), right = tr.right() / bs.width();
+	int top = tr.top() / bs.height(), bottom = tr.bottom() / bs.height();
+
+	if (left == right && top == bottom && tr.left() == left * bs.width()
+	  && tr.top() == top * bs.height()) {
+		QImage img(cachedBlock(zoom, left, top));
+		return (img.isNull() || img.size() == tr.size())
+		  ? img : img.copy(QRect(QPoint(0, 0), tr.size()));
+	}
+
+	QImage img(tr.size(), QImage::Format_ARGB32_Premultiplied);
+	img.fill(Qt::transparent);
+	QPainter painter(&img);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+
+	for (int j = top; j <= bottom; j++) {
+		for (int i = left; i <= right; i++) {
+			QImage b(cachedBlock(zoom, i, j));
+			if (b.isNull())
+				return QImage();
+			painter.drawImage(QPoint(i * bs.width(), j * bs.height())
+			  - tr.topLeft(), b);
+		}
+	}
+
+	return img;
+}
@@ -0,0 +1,77 @@
+#ifndef TIFFIMAGE_H
+#define TIFFIMAGE_H
+
+#include <QString>
+#include <QSize>
+#include <QPointF>
+#include <QVector>
+#include <QList>
+#include <QImage>
+#include <QFile>
+#include <QCache>
+#include <QPair>
+
+class TIFFFile;
+
+/* Windowed reader of tiled/striped TIFF images. Only the image blocks
+   intersecting the requested tile are read and decoded. The full resolution
+   image is zoom 0, the internal overviews (reduced-resolution IFDs) follow in
+   descending size order. */
+class TIFFImage
+{
+public:
+	TIFFImage(const QString &name) : _file(name) {}
+
+	bool open();
+	void close() {_file.close(); _strips.clear();}
+
+	QString fileName() const {return _file.fileName();}
+	QString errorString() const {return _file.errorString();}
+	bool isOpen() const {return _file.isOpen();}
+
+	int zooms() const {return _zooms.size();}
+	QSize size(int zoom) const;
+	QPointF scale(int zoom) const;
+	QSize tileSize(int zoom) const;
+	QImage tile(int zoom, int x, int y);
+
+private:
+	struct Zoom {
+		Zoom() : subfileType(0), bitsPerSample(1), compression(1),
+		  photometric(0xFFFF), samplesPerPixel(1), planarConfig(1),
+		  predictor(1), extraSamples(0), sampleFormat(1), rowsPerStrip(0) {}
+
+		quint32 subfileType;
+		QSize size;
+		QSize tileSize;
+		quint16 bitsPerSample;
+		quint16 compression;
+		quint16 photometric;
+		quint16 samplesPerPixel;
+		quint16 planarConfig;
+		quint16 predictor;
+		quint16 extraSamples;
+		quint16 sampleFormat;
+		quint32 rowsPerStrip;
+		QVector<quint32> offsets;
+		QVector<quint32> sizes;
+		QVector<QRgb> palette;
+		QByteArray jpegTables;
+	};
+
+	bool readValues(TIFFFile &file, quint32 entry, quint16 type,
+	  quint32 count, QVector<quint32> &values);
+	bool readEntry(TIFFFile &file, quint32 entry, Zoom &zoom);
+	bool readIFD(TIFFFile &file, quint32 &offset, Zoom &zoom);
+	bool isSupported(const Zoom &zoom) const;
+
+	QSize blockSize(const Zoom &zoom) const;
+	QImage block(const Zoom &zoom, int x, int y);
+	QImage cachedBlock(int zoom, int x, int y);
+
+	QFile _file;
+	QList<Zoom> _zooms;
+	QCache<QPair<int, int>, QImage> _strips;
+};
+
+#endif // TIFFIMAGE_H
@@ -0,0 +1,266 @@
+#include <QPixmap>
+#include <QMutex>
+#include <QHash>
+#include "tilecache.h"
+
+
+class Cache
+{
+public:
+	Cache() : _limit(10240 * 1024), _size(0), _nextId(0)
+	{
+		_lru.prev = &_lru;
+		_lru.next = &_lru;
+	}
+
+	quint32 addPartition(const QString &name)
+	{
+		QMutexLocker locker(&_lock);
+
+		quint32 id = _nextId++;
+		_partitions.insert(id, new Partition(name));
+
+		return id;
+	}
+
+	void removePartition(quint32 id)
+	{
+		QMutexLocker locker(&_lock);
+
+		Partition *p = _partitions.take(id);
+		clear(p);
+		delete p;
+	}
+
+	bool find(quint32 id, const TileCache::Key &key, QPixmap *pixmap)
+	{
+		QMutexLocker locker(&_lock);
+
+		Partition *p = _partitions.value(id);
+		Node *node = p->nodes.value(key);
+		if (!node) {
+			p->stats.misses++;
+			return false;
+		}
+
+		p->stats.hits++;
+		unlink(node);
+		link(node);
+		*pixmap = node->pixmap;
+
+		return true;
+	}
+
+	void insert(quint32 id, const TileCache::Key &key, const QPixmap &pixmap)
+	{
+		QMutexLocker locker(&_lock);
+
+		Partition *p = _partitions.value(id);
+		qint64 cost = (qint64)pixmap.width() * pixmap.height()
+		  * pixmap.depth() / 8;
+		if (cost > _limit)
+			return;
+
+		Node *node = p->nodes.value(key);
+		if (node)
+			remove(p, node);
+
+		node = new Node(id, key, pixmap, cost);
+		p->nodes.insert(key, node);
+		p->stats.inserts++;
+		p->stats.tiles++;
+		p->stats.size += cost;
+		_size += cost;
+		link(node);
+
+		trim(_limit);
+	}
+
+	void clear(quint32 id)
+	{
+		QMutexLocker locker(&_lock);
+		clear(_partitions.value(id));
+	}
+
+	void setLimit(qint64 limit)
+	{
+		QMutexLocker locker(&_lock);
+
+		_limit = limit;
+		trim(_limit);
+	}
+
+	TileCache::Stats stats()
+	{
+		QMutexLocker locker(&_lock);
+		TileCache::Stats s;
+
+		for (QHash<quint32, Partition*>::const_iterator it
+		  = _partitions.constBegin(); it != _partitions.constEnd(); ++it) {
+			const TileCache::Stats &ps = (*it)->stats;
+			s.hits += ps.hits;
+			s.misses += ps.misses;
+			s.inserts += ps.inserts;
+			s.evictions += ps.evictions;
+			s.tiles += ps.tiles;
+			s.size += ps.size;
+		}
+
+		return s;
+	}
+
+	QList<QPair<QString, TileCache::Stats> > partitionStats()
+	{
+		QMutexLocker locker(&_lock);
+		QList<QPair<QString, TileCache::Stats> > list;
+
+		for (QHash<quint32, Partition*>::const_iterator it
+		  = _partitions.constBegin(); it != _partitions.constEnd(); ++it)
+			list.append(QPair<QString, TileCache::Stats>((*it)->name,
+			  (*it)->stats));
+
+		return list;
+	}
+
+private:
+	struct Node {
+		Node() : prev(0), next(0), partition(0), cost(0) {}
+		Node(quint32 partition, const TileCache::Key &key,
+		  const QPixmap &pixmap, qint64 cost) : prev(0), next(0),
+		  partition(partition), key(key), pixmap(pixmap), cost(cost) {}
+
+		Node *prev, *next;
+		quint32 partition;
+		TileCache::Key key;
+		QPixmap pixmap;
+		qint64 cost;
+	};
+
+	struct Partition {
+		Partition(const QString &name) : name(name) {}
+
+		QString name;
+		QHash<TileCache::Key, Node*> nodes;
+		TileCache::Stats stats;
+	};
+
+	/* The most recently used node is _lru.next */
+	void link(Node *node)
+	{
+		node->prev = &_lru;
+		node->next = _lru.next;
+		_lru.next->prev = node;
+		_lru.next = node;
+	}
+
+	void unlink(Node *node)
+	{
+		node->prev->next = node->next;
+		node->next->prev = node->prev;
+	}
+
+	void remove(Partition *p, Node *node)
+	{
+		unlink(node);
+		p->nodes.remove(node->key);
+		p->stats.tiles--;
+		p->stats.size -= node->cost;
+		_size -= node->cost;
+		delete node;
+	}
+
+	void clear(Partition *p)
+	{
+		for (QHash<TileCache::Key, Node*>::const_iterator it
+		  = p->nodes.constBegin(); it != p->nodes.constEnd(); ++it) {
+			unlink(*it);
+			_size -= (*it)->cost;
+			delete *it;
+		}
+
+		p->nodes.clear();
+		p->stats.tiles = 0;
+		p->stats.size = 0;
+	}
+
+	void trim(qint64 limit)
+	{
+		while (_size > limit) {
+			Node *node = _lru.prev;
+			Partition *p = _partitions.value(node->partition);
+			p->stats.evictions++;
+			remove(p, node);
+		}
+	}
+
+	QMutex _lock;
+	QHash<quint32, Partition*> _partitions;
+	Node _lru;
+	qint64 _limit, _size;
+	quint32 _nextId;
+};
+
+static Cache &cache()
+{
+	static Cache c;
+	return c;
+}
+
+
+TileCache::Partition::Partition(const QString &name) : _name(name)
+{
+	_id = cache().addPartition(name);
+}
+
+TileCache::Partition::~Partition()
+{
+	cache().removePartition(_id);
+}
+
+bool TileCache::Partition::find(const Key &key, QPixmap *pixmap) const
+{
+	return cache().find(_id, key, pixmap);
+}
+
+void TileCache::Partition::insert(const Key &key, const QPixmap &pixmap)
+{
+	cache().insert(_id, key, pixmap);
+}
+
+void TileCache::Partition::clear()
+{
+	cache().clear(_id);
+}
+
+void TileCache::setLimit(int limit)
+{
+	cache().setLimit((qint64)limit * 1024);
+}
+
+TileCache::Stats TileCache::stats()
+{
+	return cache().stats();
+}
+
+QList<QPair<QString, TileCache::Stats> > TileCache::partitionStats()
+{
+	return cache().partitionStats();
+}
+
+#ifndef QT_NO_DEBUG
+QDebug operator<<(QDebug dbg, const TileCache::Key &key)
+{
+	dbg.nospace() << "Key(" << key._zoom << ", " << key._x << ", " << key._y
+	  << ", " << key._layer << ")";
+	return dbg.space();
+}
+
+QDebug operator<<(QDebug dbg, const TileCache::Stats &stats)
+{
+	dbg.nospace() << "Stats(hits: " << stats.hits << ", misses: "
+	  << stats.misses << ", inserts: " << stats.inserts << ", evictions: "
+	  << stats.evictions << ", tiles: " << stats.tiles << ", size: "
+	  << stats.size << ")";
+	return dbg.space();
+}
+#endif // QT_NO_DEBUG
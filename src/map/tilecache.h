@@ -0,0 +1,88 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QString>
+#include <QList>
+#include <QDebug>
+#include "common/config.h"
+
+class QPixmap;
+
+/* Memory cache of the map tile pixmaps. Every map uses its own partition that
+   can be invalidated independently of the other maps. The cache size limit is
+   global, the least recently used tiles (of all partitions) are evicted
+   first. All the functions are thread-safe. */
+class TileCache
+{
+public:
+	class Key
+	{
+	public:
+		Key() : _zoom(0), _layer(0), _x(0), _y(0) {}
+		Key(int zoom, int x, int y, int layer = 0)
+		  : _zoom(zoom), _layer(layer), _x(x), _y(y) {}
+
+		bool operator==(const Key &other) const
+		{
+			return (_x == other._x && _y == other._y && _zoom == other._zoom
+			  && _layer == other._layer);
+		}
+
+	private:
+		friend HASH_T qHash(const Key &key);
+		friend QDebug operator<<(QDebug dbg, const Key &key);
+
+		qint16 _zoom;
+		qint16 _layer;
+		qint32 _x, _y;
+	};
+
+	struct Stats {
+		Stats() : hits(0), misses(0), inserts(0), evictions(0), tiles(0),
+		  size(0) {}
+
+		qint64 hits;
+		qint64 misses;
+		qint64 inserts;
+		qint64 evictions;
+		int tiles;
+		qint64 size;
+	};
+
+	class Partition
+	{
+	public:
+		Partition(const QString &name);
+		~Partition();
+
+		bool find(const Key &key, QPixmap *pixmap) const;
+		void insert(const Key &key, const QPixmap &pixmap);
+		void clear();
+
+		const QString &name() const {return _name;}
+
+	private:
+		Q_DISABLE_COPY(Partition)
+
+		quint32 _id;
+		QString _name;
+	};
+
+	/* Cache size limit in kB */
+	static void setLimit(int limit);
+	static Stats stats();
+	static QList<QPair<QString, Stats> > partitionStats();
+};
+
+inline HASH_T qHash(const TileCache::Key &key)
+{
+	return ::qHash(key._x) ^ ::qHash(key._y << 16) ^ ::qHash(key._zoom)
+	  ^ ::qHash(key._layer << 8);
+}
+
+#ifndef QT_NO_DEBUG
+QDebug operator<<(QDebug dbg, const TileCache::Key &key);
+QDebug operator<<(QDebug dbg, const TileCache::Stats &stats);
+#endif // QT_NO_DEBUG
+
+#endif // TILECACHE_H
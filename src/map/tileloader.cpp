@@ -1,41 +1,25 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QEventLoop>
-#include <QPixmapCache>
 #include <QImageReader>
 #include <QtConcurrent>
 #include "tileloader.h"
 
 
-class TileImage
+void TileImage::load()
 {
-public:
-	TileImage() : _tile(0), _scaledSize(0) {}
-	TileImage(const QString &file, Tile *tile, int scaledSize)
-	  : _file(file), _tile(tile), _scaledSize(scaledSize) {}
-
-	void createPixmap()
-	{
-		_tile->pixmap().convertFromImage(_image);
-	}
-	void load()
-	{
-		QByteArray z(_tile->zoom().toString().toLatin1());
-		QImageReader reader(_file, z);
-		if (_scaledSize)
-			reader.setScaledSize(QSize(_scaledSize, _scaledSize));
-		reader.read(&_image);
-	}
-
-	const QString &file() const {return _file;}
-	Tile *tile() {return _tile;}
+	QImageReader reader(_file, _zoom);
+	if (_scaledSize)
+		reader.setScaledSize(QSize(_scaledSize, _scaledSize));
+	reader.read(&_image);
+}
 
-private:
-	QString _file;
-	Tile *_tile;
-	int _scaledSize;
-	QImage _image;
-};
+void TileImage::createPixmap()
+{
+	/* QPixmaps can only be safely created in the GUI thread */
+	_pixmap = QPixmap::fromImage(_image);
+	_image = QImage();
+}
 
 static QString quadKey(const QPoint &xy, int zoom)
 {
@@ -55,13 +39,15 @@ static QString quadKey(const QPoint &xy, int zoom)
 }
 
 TileLoader::TileLoader(const QString &dir, QObject *parent)
-  : QObject(parent), _dir(dir), _scaledSize(0), _quadTiles(false)
+  : QObject(parent), _dir(dir), _scaledSize(0), _quadTiles(false),
+  _cache(dir)
 {
 	if (!QDir().mkpath(_dir))
 		qWarning("%s: %s", qPrintable(_dir), "Error creating tiles directory");
 
 	_downloader = new Downloader(this);
-	connect(_downloader, &Downloader::finished, this, &TileLoader::finished);
+	connect(_downloader, &Downloader::finished, this,
+	  &TileLoader::downloadFinished);
 }
 
 void TileLoader::loadTilesAsync(QVector<Tile> &list)
@@ -71,19 +57,24 @@ void TileLoader::loadTilesAsync(QVector<Tile> &list)
 
 	for (int i = 0; i < list.size(); i++) {
 		Tile &t = list[i];
-		QString file(tileFile(t));
+		TileCache::Key key(tileKey(t));
 
-		if (QPixmapCache::find(file, &t.pixmap()))
+		if (_running.contains(key) || _failed.contains(key))
+			continue;
+		if (_cache.find(key, &t.pixmap()))
 			continue;
 
+		QString file(tileFile(t));
 		QFileInfo fi(file);
+		QByteArray z(t.zoom().toString().toLatin1());
 
 		if (fi.exists())
-			imgs.append(TileImage(file, &t, _scaledSize));
+			imgs.append(TileImage(file, key, z, _scaledSize));
 		else {
 			QUrl url(tileUrl(t));
 			if (url.isLocalFile())
-				imgs.append(TileImage(url.toLocalFile(), &t, _scaledSize));
+				imgs.append(TileImage(url.toLocalFile(), key, z,
+				  _scaledSize));
 			else
 				dl.append(Download(url, file));
 		}
@@ -92,40 +83,46 @@ void TileLoader::loadTilesAsync(QVector<Tile> &list)
 	if (!dl.empty())
 		_downloader->get(dl, _authorization);
 
-	QFuture<void> future = QtConcurrent::map(imgs, &TileImage::load);
-	future.waitForFinished();
-
-	for (int i = 0; i < imgs.size(); i++) {
-		TileImage &ti = imgs[i];
-		ti.createPixmap();
-		QPixmapCache::insert(ti.file(), ti.tile()->pixmap());
+	if (!imgs.isEmpty()) {
+		TileLoaderJob *job = new TileLoaderJob(imgs);
+		connect(job, &TileLoaderJob::finished, this, &TileLoader::jobFinished);
+		for (int i = 0; i < imgs.size(); i++)
+			_running.insert(imgs.at(i).key());
+		_jobs.append(job);
+		job->run();
 	}
 }
 
 void TileLoader::loadTilesSync(QVector<Tile> &list)
 {
 	QList<Download> dl;
-	QList<Tile *> tl;
+	QList<Tile *> dt;
 	QList<TileImage> imgs;
+	QList<Tile *> it;
 
 	for (int i = 0; i < list.size(); i++) {
 		Tile &t = list[i];
-		QString file(tileFile(t));
+		TileCache::Key key(tileKey(t));
 
-		if (QPixmapCache::find(file, &t.pixmap()))
+		if (_cache.find(key, &t.pixmap()))
 			continue;
 
+		QString file(tileFile(t));
 		QFileInfo fi(file);
+		QByteArray z(t.zoom().toString().toLatin1());
 
-		if (fi.exists())
-			imgs.append(TileImage(file, &t, _scaledSize));
-		else {
+		if (fi.exists()) {
+			imgs.append(TileImage(file, key, z, _scaledSize));
+			it.append(&t);
+		} else {
 			QUrl url(tileUrl(t));
-			if (url.isLocalFile())
-				imgs.append(TileImage(url.toLocalFile(), &t, _scaledSize));
-			else {
+			if (url.isLocalFile()) {
+				imgs.append(TileImage(url.toLocalFile(), key, z,
+				  _scaledSize));
+				it.append(&t);
+			} else {
 				dl.append(Download(url, file));
-				tl.append(&t);
+				dt.append(&t);
 			}
 		}
 	}
@@ -136,23 +133,75 @@ void TileLoader::loadTilesSync(QVector<Tile> &list)
 		if (_downloader->get(dl, _authorization))
 			wait.exec();
 
-		for (int i = 0; i < tl.size(); i++) {
-			Tile *t = tl[i];
+		for (int i = 0; i < dt.size(); i++) {
+			Tile *t = dt[i];
 			QString file = tileFile(*t);
-			if (QFileInfo(file).exists())
-				imgs.append(TileImage(file, t, _scaledSize));
+			if (QFileInfo(file).exists()) {
+				imgs.append(TileImage(file, tileKey(*t),
+				  t->zoom().toString().toLatin1(), _scaledSize));
+				it.append(t);
+			}
 		}
 	}
 
 	QFuture<void> future = QtConcurrent::map(imgs, &TileImage::load);
 	future.waitForFinished();
 
-	for (int i = 0; i < imgs.size(); i++)
-		imgs[i].createPixmap();
+	for (int i = 0; i < imgs.size(); i++) {
+		TileImage &ti = imgs[i];
+		ti.createPixmap();
+		it[i]->pixmap() = ti.pixmap();
+	}
+}
+
+/* Tiles that can not be decoded (e.g. error pages saved as tiles) are not
+   queued again until the next download finishes or the cache is cleared,
+   otherwise the repaint would start a new decoding job in an endless loop. */
+void TileLoader::jobFinished(TileLoaderJob *job)
+{
+	const QList<TileImage> &images = job->images();
+	bool loaded = false;
+
+	for (int i = 0; i < images.size(); i++) {
+		const TileImage &ti = images.at(i);
+		if (ti.pixmap().isNull())
+			_failed.insert(ti.key());
+		else {
+			_cache.insert(ti.key(), ti.pixmap());
+			loaded = true;
+		}
+		_running.remove(ti.key());
+	}
+
+	_jobs.removeOne(job);
+	if (loaded)
+		emit finished();
+}
+
+void TileLoader::downloadFinished()
+{
+	_failed.clear();
+	emit finished();
+}
+
+/* The results of the running jobs would be inserted into the cleared cache
+   (with the old scaled size) under the same keys, so the jobs are dropped. */
+void TileLoader::dropJobs()
+{
+	for (int i = 0; i < _jobs.size(); i++)
+		_jobs.at(i)->cancel();
+	for (int i = 0; i < _jobs.size(); i++) {
+		_jobs.at(i)->wait();
+		_jobs.at(i)->disconnect(this);
+	}
+	_jobs.clear();
+	_running.clear();
 }
 
 void TileLoader::clearCache()
 {
+	dropJobs();
+
 	QDir dir = QDir(_dir);
 	QStringList list = dir.entryList();
 
@@ -161,7 +210,8 @@ void TileLoader::clearCache()
 
 	_downloader->clearErrors();
 
-	QPixmapCache::clear();
+	_cache.clear();
+	_failed.clear();
 }
 
 void TileLoader::setScaledSize(int size)
@@ -170,7 +220,8 @@ void TileLoader::setScaledSize(int size)
 		return;
 
 	_scaledSize = size;
-	QPixmapCache::clear();
+	dropJobs();
+	_cache.clear();
 }
 
 QUrl TileLoader::tileUrl(const Tile &tile) const
@@ -201,3 +252,15 @@ QString TileLoader::tileFile(const Tile &tile) const
 	  + QString::number(tile.xy().x()) + QLatin1Char('-')
 	  + QString::number(tile.xy().y());
 }
+
+TileCache::Key TileLoader::tileKey(const Tile &tile)
+{
+	/* The zoom may be an arbitrary string (WMTS), so the zoom levels are
+	   mapped to (per loader) integer IDs */
+	QString zoom(tile.zoom().toString());
+	QHash<QString, int>::const_iterator it = _zooms.find(zoom);
+	if (it == _zooms.constEnd())
+		it = _zooms.insert(zoom, _zooms.size());
+
+	return TileCache::Key(*it, tile.xy().x(), tile.xy().y());
+}
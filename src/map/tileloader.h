@@ -3,9 +3,78 @@
 
 #include <QObject>
 #include <QString>
+#include <QSet>
+#include <QImage>
+#include <QtConcurrent>
 #include "tile.h"
+#include "tilecache.h"
 #include "downloader.h"
 
+class TileImage
+{
+public:
+	TileImage() : _scaledSize(0) {}
+	TileImage(const QString &file, const TileCache::Key &key,
+	  const QByteArray &zoom, int scaledSize) : _file(file), _key(key),
+	  _zoom(zoom), _scaledSize(scaledSize) {}
+
+	void load();
+	void createPixmap();
+
+	const QString &file() const {return _file;}
+	const TileCache::Key &key() const {return _key;}
+	const QPixmap &pixmap() const {return _pixmap;}
+
+private:
+	QString _file;
+	TileCache::Key _key;
+	QByteArray _zoom;
+	int _scaledSize;
+	QImage _image;
+	QPixmap _pixmap;
+};
+
+class TileLoaderJob : public QObject
+{
+	Q_OBJECT
+
+public:
+	TileLoaderJob(const QList<TileImage> &images) : _images(images)
+	{
+		connect(&_watcher, &QFutureWatcher<void>::finished, this,
+		  &TileLoaderJob::handleFinished);
+	}
+
+	void run()
+	{
+		_future = QtConcurrent::map(_images, &TileImage::load);
+		_watcher.setFuture(_future);
+	}
+	void cancel() {_future.cancel();}
+	void wait() {_future.waitForFinished();}
+
+	const QList<TileImage> &images() const {return _images;}
+
+signals:
+	void finished(TileLoaderJob *job);
+
+private slots:
+	void handleFinished()
+	{
+		for (int i = 0; i < _images.size(); i++)
+			_images[i].createPixmap();
+
+		emit finished(this);
+
+		deleteLater();
+	}
+
+private:
+	QFutureWatcher<void> _watcher;
+	QFuture<void> _future;
+	QList<TileImage> _images;
+};
+
 class TileLoader : public QObject
 {
 	Q_OBJECT
@@ -26,9 +95,15 @@ public:
 signals:
 	void finished();
 
+private slots:
+	void jobFinished(TileLoaderJob *job);
+	void downloadFinished();
+
 private:
 	QUrl tileUrl(const Tile &tile) const;
 	QString tileFile(const Tile &tile) const;
+	TileCache::Key tileKey(const Tile &tile);
+	void dropJobs();
 
 	Downloader *_downloader;
 	QString _url;
@@ -36,6 +111,12 @@ private:
 	Authorization _authorization;
 	int _scaledSize;
 	bool _quadTiles;
+
+	TileCache::Partition _cache;
+	QHash<QString, int> _zooms;
+	QSet<TileCache::Key> _running;
+	QSet<TileCache::Key> _failed;
+	QList<TileLoaderJob*> _jobs;
 };
 
-#endif // TILELOADER_Honlinemap
+#endif // TILELOADER_H